@@ -0,0 +1,125 @@
+// Counts heap allocations made while decoding a waveform file, comparing the
+// per-event TreeData path with the columnar EventBatch sample pool.
+//
+//   bench_alloc [events] [samples-per-trace]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+#include <capnp/message.h>
+#include <capnp/serialize-packed.h>
+#include "CapnpReader.h"
+
+namespace {
+
+std::atomic<size_t> gAllocations{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+// Writes `packets` DualWaveData messages of 1000 events each
+void WriteDualWaveFile(int fd, int packets, int samples) {
+    for (int p = 0; p < packets; p++) {
+        capnp::MallocMessageBuilder message;
+        auto data = message.initRoot<DualWaveData>();
+        data.setType(3);
+        auto events = data.initEvents(1000);
+        for (unsigned i = 0; i < events.size(); i++) {
+            auto event = events[i];
+            event.setBoard(i % 4);
+            event.setChannel(i % 16);
+            event.setEnergy(i);
+            event.setTimestamp(static_cast<uint64_t>(p) * 1000 + i);
+            auto wave1 = event.initWaveform1(samples);
+            auto wave2 = event.initWaveform2(samples);
+            for (int s = 0; s < samples; s++) {
+                wave1.set(s, s);
+                wave2.set(s, -s);
+            }
+        }
+        capnp::writePackedMessageToFd(fd, message);
+    }
+}
+
+void Report(const std::string& name, size_t allocations, size_t events) {
+    std::cout << std::left << std::setw(28) << name << std::right
+              << std::setw(12) << allocations << " allocations  "
+              << std::fixed << std::setprecision(3)
+              << std::setw(8) << (events ? double(allocations) / events : 0.0)
+              << " per event\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int packets = argc > 1 ? std::atoi(argv[1]) / 1000 : 100;
+    int samples = argc > 2 ? std::atoi(argv[2]) : 512;
+    if (packets < 1) {
+        packets = 1;
+    }
+
+    char path[] = "/tmp/bench_alloc_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot create temporary file\n";
+        return 1;
+    }
+    WriteDualWaveFile(fd, packets, samples);
+    close(fd);
+
+    std::cout << "DualWaveData: " << packets * 1000 << " events, "
+              << samples << " samples per trace\n";
+
+    // Per-event TreeData objects, each with its own trace vectors
+    {
+        CapnpReader reader;
+        reader.Open(path);
+        size_t events = 0;
+        size_t before = gAllocations.load();
+        while (reader.HasNext()) {
+            auto packet = reader.ReadNextPacket();
+            if (packet.empty()) {
+                break;
+            }
+            events += packet.size();
+        }
+        Report("TreeData per event", gAllocations.load() - before, events);
+    }
+
+    // Whole run decoded into one batch and its sample pool
+    {
+        CapnpReader reader;
+        reader.Open(path);
+        EventBatch batch;
+        size_t before = gAllocations.load();
+        while (reader.HasNext()) {
+            if (reader.ReadNextPacket(batch) == 0) {
+                break;
+            }
+        }
+        Report("EventBatch sample pool", gAllocations.load() - before, batch.Size());
+    }
+
+    unlink(path);
+    return 0;
+}
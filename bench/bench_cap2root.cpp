@@ -0,0 +1,404 @@
+// Throughput of each conversion stage on files written by EventGenerator,
+// reported as events/s and MB/s (bytes of the .cap input, or of the
+// uncompressed tree payload for the fill stage):
+//
+//   ReadUnpack   read and unpack messages, no per-event work
+//   DecodeTreeData / DecodeBatch   CapnpReader into TreeData or EventBatch
+//   DecodeWaveforms                DecodeBatch of dual-waveform inputs
+//                                  (type, samples per trace)
+//   CopyWaveform                   the waveform copy alone (samples, 0 per
+//                                  sample through the list iterator or 1
+//                                  bulk with CopySamples)
+//   SortStable / SortMerge / SortRadix   timestamp ordering of a decoded
+//                                  file (SortRadix: type, threads)
+//   Fill / FillBatch               RootWriter per event or per batch
+//   ReadTTree / ReadRNTuple        reading the converted output back, all
+//                                  fields including Signal (RNTuple only
+//                                  when built with CAP2ROOT_HAVE_RNTUPLE)
+//
+// The argument of each benchmark is the event type (0 plain, 2 wave, ...)
+// unless noted.
+#include <benchmark/benchmark.h>
+#include <map>
+#include <string>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <capnp/any.h>
+#include "CapnpReader.h"
+#include "EventGenerator.h"
+#include "EventWriter.h"
+#include "RootWriter.h"
+#include "RunMerger.h"
+#include "SampleCopy.h"
+#include "TFile.h"
+#include "TTree.h"
+#ifdef CAP2ROOT_HAVE_RNTUPLE
+#include <ROOT/RNTupleReader.hxx>
+#include "NTupleWriter.h"
+#endif
+
+namespace {
+
+const size_t kEvents = 200000;
+const uint32_t kSamples = 256;
+
+struct InputFile {
+    std::string path;
+    size_t bytes = 0;
+};
+
+// Generated once per (type, trace length) and removed at exit
+std::map<std::pair<int, uint32_t>, InputFile>& InputFiles() {
+    static std::map<std::pair<int, uint32_t>, InputFile> files;
+    return files;
+}
+
+// Longer traces get proportionally fewer events, so every input holds about
+// the same number of samples
+const InputFile& GetInput(int type, uint32_t samples = kSamples) {
+    auto& files = InputFiles();
+    auto key = std::make_pair(type, samples);
+    auto it = files.find(key);
+    if (it != files.end()) {
+        return it->second;
+    }
+
+    GeneratorConfig config;
+    config.type = type;
+    config.events = samples > kSamples ? kEvents * kSamples / samples : kEvents;
+    config.samples = samples;
+    config.disorder = 0.01;
+
+    InputFile& file = files[key];
+    file.path = "/tmp/bench_cap2root_" + std::to_string(getpid()) + "_"
+              + EventGenerator::TypeName(type) + "_" + std::to_string(samples) + ".cap";
+    EventGenerator(config).Write(file.path);
+    struct stat st;
+    if (stat(file.path.c_str(), &st) == 0) {
+        file.bytes = st.st_size;
+    }
+    return file;
+}
+
+// Converted outputs per (format, type), written once with FillBatch
+std::map<std::pair<std::string, int>, std::string>& OutputFiles() {
+    static std::map<std::pair<std::string, int>, std::string> files;
+    return files;
+}
+
+void RemoveInputs() {
+    for (auto& entry : InputFiles()) {
+        std::remove(entry.second.path.c_str());
+    }
+    for (auto& entry : OutputFiles()) {
+        std::remove(entry.second.c_str());
+    }
+}
+
+void SetThroughput(benchmark::State& state, size_t events, size_t bytes) {
+    state.SetItemsProcessed(state.iterations() * events);
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+EventBatch DecodeAll(const std::string& path) {
+    CapnpReader reader;
+    reader.Open(path);
+    EventBatch batch;
+    while (reader.HasNext()) {
+        reader.ReadNextPacket(batch);
+    }
+    return batch;
+}
+
+// Uncompressed payload of the output fields
+size_t OutputBytes(const EventBatch& batch) {
+    return batch.Size() * (1 + 1 + 8 + 8 + 2 + 2 + 4 + 4) + batch.Samples.size() * 2;
+}
+
+void BM_ReadUnpack(benchmark::State& state) {
+    const InputFile& input = GetInput(state.range(0));
+    size_t events = 0;
+    for (auto _ : state) {
+        int fd = open(input.path.c_str(), O_RDONLY);
+        kj::FdInputStream fdStream(fd);
+        kj::BufferedInputStreamWrapper bufferedStream(fdStream);
+        events = 0;
+        while (bufferedStream.tryGetReadBuffer() != nullptr) {
+            capnp::PackedMessageReader message(bufferedStream, {100000000, 64});
+            events += message.getRoot<PlainData>().getEvents().size();
+        }
+        close(fd);
+        benchmark::DoNotOptimize(events);
+    }
+    SetThroughput(state, events, input.bytes);
+}
+
+void BM_DecodeTreeData(benchmark::State& state) {
+    const InputFile& input = GetInput(state.range(0));
+    size_t events = 0;
+    for (auto _ : state) {
+        CapnpReader reader;
+        reader.Open(input.path);
+        events = 0;
+        while (reader.HasNext()) {
+            events += reader.ReadNextPacket().size();
+        }
+    }
+    SetThroughput(state, events, input.bytes);
+}
+
+void BM_DecodeBatch(benchmark::State& state) {
+    const InputFile& input = GetInput(state.range(0));
+    EventBatch batch;
+    for (auto _ : state) {
+        batch.Clear();
+        CapnpReader reader;
+        reader.Open(input.path);
+        while (reader.HasNext()) {
+            reader.ReadNextPacket(batch);
+        }
+    }
+    SetThroughput(state, batch.Size(), input.bytes);
+}
+
+void BM_DecodeWaveforms(benchmark::State& state) {
+    const InputFile& input = GetInput(state.range(0), state.range(1));
+    EventBatch batch;
+    for (auto _ : state) {
+        batch.Clear();
+        CapnpReader reader;
+        reader.Open(input.path);
+        while (reader.HasNext()) {
+            reader.ReadNextPacket(batch);
+        }
+    }
+    SetThroughput(state, batch.Size(), input.bytes);
+}
+
+// Copies both traces of every event of the first DualWaveData packet;
+// bytes are the trace bytes written
+void BM_CopyWaveform(benchmark::State& state) {
+    const uint32_t samples = state.range(0);
+    const bool bulk = state.range(1) != 0;
+    const InputFile& input = GetInput(3, samples);
+
+    int fd = open(input.path.c_str(), O_RDONLY);
+    kj::FdInputStream fdStream(fd);
+    kj::BufferedInputStreamWrapper bufferedStream(fdStream);
+    capnp::PackedMessageReader message(bufferedStream, {100000000, 64});
+    auto events = message.getRoot<DualWaveData>().getEvents();
+
+    std::vector<uint16_t> traces(events.size() * 2 * samples);
+    for (auto _ : state) {
+        uint16_t* out = traces.data();
+        for (auto event : events) {
+            for (auto wave : {event.getWaveform1(), event.getWaveform2()}) {
+                if (bulk) {
+                    CopySamples(capnp::AnyList::Reader(wave).getRawBytes().begin(), wave.size(), out);
+                    out += wave.size();
+                } else {
+                    for (auto val : wave) {
+                        *out++ = val;
+                    }
+                }
+            }
+        }
+        benchmark::DoNotOptimize(traces.data());
+    }
+    close(fd);
+    SetThroughput(state, events.size(), traces.size() * sizeof(uint16_t));
+}
+
+void BM_SortStable(benchmark::State& state) {
+    const InputFile& input = GetInput(state.range(0));
+    EventBatch batch = DecodeAll(input.path);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(batch.StableTimeOrder());
+    }
+    SetThroughput(state, batch.Size(), input.bytes);
+}
+
+void BM_SortMerge(benchmark::State& state) {
+    const InputFile& input = GetInput(state.range(0));
+    EventBatch batch = DecodeAll(input.path);
+    for (auto _ : state) {
+        // Observe() scans from its argument to the end of the batch
+        RunMerger merger;
+        merger.Observe(batch, 0);
+        benchmark::DoNotOptimize(merger.Merge(batch));
+    }
+    SetThroughput(state, batch.Size(), input.bytes);
+}
+
+void BM_SortRadix(benchmark::State& state) {
+    const InputFile& input = GetInput(state.range(0));
+    EventBatch batch = DecodeAll(input.path);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(batch.RadixTimeOrder(state.range(1)));
+    }
+    SetThroughput(state, batch.Size(), input.bytes);
+}
+
+void BM_Fill(benchmark::State& state) {
+    const InputFile& input = GetInput(state.range(0));
+    EventBatch batch = DecodeAll(input.path);
+    const std::string output = input.path + ".root";
+
+    size_t bytes = OutputBytes(batch);
+
+    for (auto _ : state) {
+        RootWriter writer(output);
+        for (size_t i = 0; i < batch.Size(); i++) {
+            writer.Fill(batch.View(i));
+        }
+        writer.Close();
+    }
+    std::remove(output.c_str());
+    SetThroughput(state, batch.Size(), bytes);
+}
+
+void BM_FillBatch(benchmark::State& state) {
+    const InputFile& input = GetInput(state.range(0));
+    EventBatch batch = DecodeAll(input.path);
+    const std::string output = input.path + ".root";
+
+    size_t bytes = OutputBytes(batch);
+
+    for (auto _ : state) {
+        RootWriter writer(output);
+        writer.FillBatch(batch);
+        writer.Close();
+    }
+    std::remove(output.c_str());
+    SetThroughput(state, batch.Size(), bytes);
+}
+
+const std::string& GetOutput(const std::string& format, int type) {
+    auto& files = OutputFiles();
+    auto key = std::make_pair(format, type);
+    auto it = files.find(key);
+    if (it == files.end()) {
+        const InputFile& input = GetInput(type);
+        std::string path = input.path + "." + format + ".root";
+        auto writer = EventWriter::Create(format, path, 101);
+        writer->FillBatch(DecodeAll(input.path));
+        writer->Close();
+        it = files.emplace(key, path).first;
+    }
+    return it->second;
+}
+
+void BM_ReadTTree(benchmark::State& state) {
+    const std::string& path = GetOutput("ttree", state.range(0));
+    EventBatch batch = DecodeAll(GetInput(state.range(0)).path);
+
+    uint8_t mod, ch;
+    uint64_t timeStamp;
+    double fineTS;
+    uint16_t chargeLong, chargeShort;
+    uint32_t recordLength;
+    std::vector<uint16_t> signal(kSamples);
+    for (auto _ : state) {
+        TFile file(path.c_str());
+        TTree* tree = file.Get<TTree>("ELIADE_Tree");
+        tree->SetBranchAddress("Mod", &mod);
+        tree->SetBranchAddress("Ch", &ch);
+        tree->SetBranchAddress("TimeStamp", &timeStamp);
+        tree->SetBranchAddress("FineTS", &fineTS);
+        tree->SetBranchAddress("ChargeLong", &chargeLong);
+        tree->SetBranchAddress("ChargeShort", &chargeShort);
+        tree->SetBranchAddress("RecordLength", &recordLength);
+        tree->SetBranchAddress("Signal", signal.data());
+
+        uint64_t sum = 0;
+        const Long64_t entries = tree->GetEntries();
+        for (Long64_t entry = 0; entry < entries; entry++) {
+            tree->GetEntry(entry);
+            sum += timeStamp + chargeLong + (recordLength ? signal[recordLength / 2] : 0);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    SetThroughput(state, batch.Size(), OutputBytes(batch));
+}
+
+#ifdef CAP2ROOT_HAVE_RNTUPLE
+void BM_ReadRNTuple(benchmark::State& state) {
+    const std::string& path = GetOutput("rntuple", state.range(0));
+    EventBatch batch = DecodeAll(GetInput(state.range(0)).path);
+
+    for (auto _ : state) {
+        auto reader = RNTupleAPI::RNTupleReader::Open("ELIADE_Tree", path);
+        auto mod = reader->GetView<uint8_t>("Mod");
+        auto ch = reader->GetView<uint8_t>("Ch");
+        auto timeStamp = reader->GetView<uint64_t>("TimeStamp");
+        auto fineTS = reader->GetView<double>("FineTS");
+        auto chargeLong = reader->GetView<uint16_t>("ChargeLong");
+        auto chargeShort = reader->GetView<uint16_t>("ChargeShort");
+        auto recordLength = reader->GetView<uint32_t>("RecordLength");
+        auto signal = reader->GetView<std::vector<uint16_t>>("Signal");
+
+        uint64_t sum = 0;
+        for (auto entry : reader->GetEntryRange()) {
+            const std::vector<uint16_t>& trace = signal(entry);
+            sum += mod(entry) + ch(entry) + timeStamp(entry) + chargeLong(entry)
+                 + chargeShort(entry) + recordLength(entry)
+                 + static_cast<uint64_t>(fineTS(entry))
+                 + (trace.empty() ? 0 : trace[trace.size() / 2]);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    SetThroughput(state, batch.Size(), OutputBytes(batch));
+}
+#endif
+
+// Plain, PSD, single and dual waveform inputs
+void EventTypes(benchmark::internal::Benchmark* bench) {
+    for (int type : {0, 1, 2, 3}) {
+        bench->Arg(type);
+    }
+    bench->Unit(benchmark::kMillisecond);
+}
+
+// DualWaveData and FullData with 256 to 8192 samples per trace
+void TraceLengths(benchmark::internal::Benchmark* bench) {
+    for (int type : {3, 4}) {
+        for (int samples = 256; samples <= 8192; samples *= 2) {
+            bench->Args({type, samples});
+        }
+    }
+    bench->Unit(benchmark::kMillisecond);
+}
+
+void CopyModes(benchmark::internal::Benchmark* bench) {
+    for (int samples = 256; samples <= 8192; samples *= 2) {
+        bench->Args({samples, 0})->Args({samples, 1});
+    }
+}
+
+BENCHMARK(BM_ReadUnpack)->Apply(EventTypes);
+BENCHMARK(BM_DecodeTreeData)->Apply(EventTypes);
+BENCHMARK(BM_DecodeBatch)->Apply(EventTypes);
+BENCHMARK(BM_DecodeWaveforms)->Apply(TraceLengths);
+BENCHMARK(BM_CopyWaveform)->Apply(CopyModes);
+BENCHMARK(BM_SortStable)->Apply(EventTypes);
+BENCHMARK(BM_SortMerge)->Apply(EventTypes);
+BENCHMARK(BM_SortRadix)->Args({0, 1})->Args({0, 4})->Args({2, 1})->Args({2, 4})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Fill)->Apply(EventTypes);
+BENCHMARK(BM_FillBatch)->Apply(EventTypes);
+BENCHMARK(BM_ReadTTree)->Apply(EventTypes);
+#ifdef CAP2ROOT_HAVE_RNTUPLE
+BENCHMARK(BM_ReadRNTuple)->Apply(EventTypes);
+#endif
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    RemoveInputs();
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Measures RootWriter throughput and compression ratio on generated events,
+// for one compression setting and one or more ROOT implicit-MT threads.
+// With 0 samples per trace the events carry no waveform, like PlainData.
+//
+//   bench_write [events] [samples-per-trace] [write-threads] [compression]
+//
+// The implicit-MT pool is process-wide, so compare thread counts by running
+// the benchmark once per setting.
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <unistd.h>
+#include "RootWriter.h"
+
+int main(int argc, char** argv) {
+    long events = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int samples = argc > 2 ? std::atoi(argv[2]) : 512;
+    int threads = argc > 3 ? std::atoi(argv[3]) : 1;
+    std::string compressionSpec = argc > 4 ? argv[4] : "zlib:1";
+    int compression = 0;
+    if (events < 1 || samples < 0 || threads < 1
+        || !RootWriter::ParseCompression(compressionSpec, compression)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [events] [samples-per-trace] [write-threads] [compression]\n";
+        return 1;
+    }
+
+    RootWriter::EnableParallelCompression(threads);
+
+    std::string path = "/tmp/bench_write_" + std::to_string(getpid()) + ".root";
+
+    // A noisy pulse so the compressor has realistic work to do
+    TreeData data;
+    data.RecordLength = samples;
+    data.Trace1.resize(samples);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        RootWriter writer(path, compression);
+        for (long i = 0; i < events; i++) {
+            data.Mod = i % 4;
+            data.Ch = i % 16;
+            data.TimeStamp = i * 40;
+            data.FineTS = i * 40.0;
+            data.ChargeLong = (i * 7919) & 0xFFFF;
+            data.ChargeShort = (i * 104729) & 0xFFFF;
+            for (int s = 0; s < samples; s++) {
+                data.Trace1[s] = 8000 + ((s * 31 + i * 17) & 0x3F) + (s > samples / 4 ? 500 : 0);
+            }
+            writer.Fill(data);
+        }
+        writer.Close();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Payload bytes as declared by the branch leaf types
+    double rawBytes = double(events) * (1 + 1 + 8 + 8 + 2 + 2 + 4 + 2.0 * samples);
+    double fileBytes = double(std::filesystem::file_size(path));
+    std::filesystem::remove(path);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << events << " events, " << samples << " samples, "
+              << threads << " write threads, " << compressionSpec << "\n"
+              << "  time         " << seconds << " s\n"
+              << "  throughput   " << rawBytes / (1024 * 1024) / seconds << " MB/s (uncompressed)\n"
+              << "  ratio        " << rawBytes / fileBytes << "\n";
+    return 0;
+}
@@ -0,0 +1,24 @@
+#!/bin/bash
+# Prints a Markdown table of write throughput and compression ratio for each
+# output compression setting, on PlainData-like (no waveform) and
+# WaveData-like (512-sample trace) events.
+#
+#   bench/compression_table.sh [path/to/bench_write] [events] [write-threads]
+set -e
+
+BENCH=${1:-./bench_write}
+EVENTS=${2:-1000000}
+THREADS=${3:-1}
+
+echo "| Setting | Input | MB/s | Ratio |"
+echo "|---------|-------|-----:|------:|"
+for setting in none zlib:1 lz4:4 zstd:5 zstd:9 lzma:7; do
+    for input in "PlainData:0" "WaveData:512"; do
+        name=${input%%:*}
+        samples=${input##*:}
+        "$BENCH" "$EVENTS" "$samples" "$THREADS" "$setting" | awk -v s="$setting" -v n="$name" '
+            /throughput/ { mbs = $2 }
+            /ratio/      { ratio = $2 }
+            END          { printf "| %s | %s | %s | %s |\n", s, n, mbs, ratio }'
+    done
+done
@@ -2,10 +2,11 @@
 
 # Parallel cap to ROOT converter
 # Converts all .cap files in current directory to .root format
-# Uses 10 parallel threads for conversion
+# Uses 10 parallel threads for conversion, inside one cap2root process
+# (cap2root --batch); existing outputs are skipped
 
 # Number of parallel jobs
-NJOBS=10
+NJOBS=${NJOBS:-10}
 
 # Determine cap2root location
 # First check if cap2root is available and working
@@ -41,43 +42,6 @@ echo "Using cap2root: $CAP2ROOT"
 echo "Starting conversion with $NJOBS parallel threads..."
 echo ""
 
-# Function to convert a single file
-convert_file() {
-    local input="$1"
-    local output="${input%.cap}.root"
-
-    # Check if output already exists
-    if [ -f "$output" ]; then
-        echo "[SKIP] $input -> $output (already exists)"
-        return 0
-    fi
-
-    echo "[START] Converting $input..."
-
-    # Run conversion
-    if "$CAP2ROOT" "$input" "$output" > /dev/null 2>&1; then
-        echo "[DONE] $input -> $output"
-    else
-        echo "[ERROR] Failed to convert $input"
-        return 1
-    fi
-}
-
-# Export function so it can be used by parallel processes
-export -f convert_file
-export CAP2ROOT
-
-# Use GNU parallel if available, otherwise use xargs
-if command -v parallel &> /dev/null; then
-    # GNU parallel method (preferred)
-    printf '%s\n' "${cap_files[@]}" | parallel -j $NJOBS convert_file
-else
-    # Fallback using xargs with background jobs
-    printf '%s\n' "${cap_files[@]}" | xargs -n 1 -P $NJOBS -I {} bash -c 'convert_file "$@"' _ {}
-fi
-
-echo ""
-echo "Conversion complete!"
-echo "Summary:"
-echo "  Total .cap files: ${#cap_files[@]}"
-echo "  ROOT files created: $(ls -1 *.root 2>/dev/null | wc -l)"
+# One process converts all files; it schedules them by size within the
+# memory budget (--max-memory, default half of RAM) and skips existing outputs
+"$CAP2ROOT" --batch . --threads "$NJOBS" "$@"
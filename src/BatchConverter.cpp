@@ -0,0 +1,226 @@
+#include "BatchConverter.h"
+#include "CapnpReader.h"
+#include "EventWriter.h"
+#include "ExternalSorter.h"
+#include "RunMerger.h"
+#include "TROOT.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Peak memory of an in-memory conversion per byte of packed input: the
+// decoded columns (up to twice their size while growing), the sort
+// permutation and the run bookkeeping.  Conservative for unpacked input,
+// which is larger on disk for the same events.
+const size_t kMemoryPerInputByte = 4;
+
+bool FileExists(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+std::string BaseName(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+size_t PhysicalMemory() {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    return pages > 0 && pageSize > 0 ? static_cast<size_t>(pages) * pageSize : 0;
+}
+
+}  // namespace
+
+BatchConverter::BatchConverter(const BatchSettings& settings)
+    : settings_(settings) {
+    if (settings_.threads == 0) {
+        settings_.threads = 1;
+    }
+    // Without a budget, half of the machine's memory is shared by the jobs
+    if (settings_.memoryBudget == 0) {
+        settings_.memoryBudget = std::max<size_t>(PhysicalMemory() / 2, 512 * 1024 * 1024);
+    }
+}
+
+size_t BatchConverter::EstimateMemory(uint64_t fileBytes) {
+    return fileBytes * kMemoryPerInputByte;
+}
+
+bool BatchConverter::Plan(const std::string& inputDir, const std::string& outputDir) {
+    const std::string outDir = outputDir.empty() ? inputDir : outputDir;
+
+    glob_t matches;
+    if (glob((inputDir + "/*.cap").c_str(), 0, nullptr, &matches) != 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < matches.gl_pathc; i++) {
+        Job job;
+        job.input = matches.gl_pathv[i];
+        std::string name = BaseName(job.input);
+        job.output = outDir + "/" + name.substr(0, name.size() - 4) + ".root";
+
+        if (FileExists(job.output)) {
+            std::cout << "[SKIP] " << job.input << " -> " << job.output
+                      << " (already exists)\n";
+            skipped_++;
+            continue;
+        }
+
+        struct stat st;
+        job.bytes = stat(job.input.c_str(), &st) == 0 ? st.st_size : 0;
+        job.memory = EstimateMemory(job.bytes);
+        if (job.memory > settings_.memoryBudget) {
+            job.external = true;
+            job.memory = settings_.memoryBudget;
+        }
+        jobs_.push_back(job);
+    }
+    globfree(&matches);
+
+    // Largest first, so big files do not end up alone at the tail
+    std::stable_sort(jobs_.begin(), jobs_.end(), [](const Job& a, const Job& b) {
+        return a.bytes > b.bytes;
+    });
+    return true;
+}
+
+size_t BatchConverter::Run() {
+    started_.assign(jobs_.size(), false);
+    pending_ = jobs_.size();
+    running_ = 0;
+    reserved_ = 0;
+
+    unsigned workers = std::max(1u, std::min<unsigned>(settings_.threads, jobs_.size()));
+    if (workers > 1) {
+        // Several TFiles are created and written from different threads
+        ROOT::EnableThreadSafety();
+    }
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < workers; i++) {
+        threads.emplace_back(&BatchConverter::Worker, this);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return failed_;
+}
+
+void BatchConverter::Worker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (pending_ > 0) {
+        // The largest pending file that fits next to the running ones; any
+        // file may start when nothing else runs
+        size_t pick = jobs_.size();
+        for (size_t i = 0; i < jobs_.size(); i++) {
+            if (!started_[i]
+                && (running_ == 0 || reserved_ + jobs_[i].memory <= settings_.memoryBudget)) {
+                pick = i;
+                break;
+            }
+        }
+        if (pick == jobs_.size()) {
+            admitted_.wait(lock);
+            continue;
+        }
+
+        const Job& job = jobs_[pick];
+        started_[pick] = true;
+        pending_--;
+        running_++;
+        reserved_ += job.memory;
+        std::cout << "[START] Converting " << job.input
+                  << (job.external ? " (external sort)" : "") << "...\n";
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        size_t events = 0;
+        std::string error;
+        bool ok;
+        try {
+            ok = Convert(job, events, error);
+        } catch (const std::exception& e) {
+            error = e.what();
+            ok = false;
+        }
+        if (!ok) {
+            std::remove((job.output + ".part").c_str());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        running_--;
+        reserved_ -= job.memory;
+        if (ok) {
+            converted_++;
+            std::cout << "[DONE] " << job.input << " -> " << job.output << " ("
+                      << events << " events, " << seconds << " s)\n";
+        } else {
+            failed_++;
+            std::cerr << "[ERROR] Failed to convert " << job.input << ": " << error << "\n";
+        }
+        admitted_.notify_all();
+    }
+}
+
+bool BatchConverter::Convert(const Job& job, size_t& events, std::string& error) {
+    CapnpReader reader;
+    if (!reader.Open(job.input)) {
+        error = "cannot open input file";
+        return false;
+    }
+    reader.SetFilter(settings_.filter);
+
+    // Written under a temporary name so that an interrupted conversion is
+    // not mistaken for a finished one on the next run
+    const std::string partial = job.output + ".part";
+    auto writer = EventWriter::Create(settings_.format, partial, settings_.compression);
+    EventBatch packet;
+
+    if (job.external) {
+        ExternalSorter sorter(job.memory, settings_.tmpDir);
+        while (reader.HasNext()) {
+            packet.Clear();
+            if (reader.ReadNextPacket(packet) > 0) {
+                sorter.Add(packet);
+            }
+        }
+        sorter.Merge([&](const EventBatch& batch, size_t i) {
+            writer->Fill(batch.View(i));
+        });
+        events = sorter.NumEvents();
+    } else {
+        EventBatch allEvents;
+        RunMerger merger;
+        while (reader.HasNext()) {
+            packet.Clear();
+            if (reader.ReadNextPacket(packet) > 0) {
+                size_t first = allEvents.Size();
+                allEvents.Append(packet);
+                merger.Observe(allEvents, first);
+            }
+        }
+        std::vector<size_t> order = merger.Merge(allEvents);
+        writer->FillBatch(allEvents, 0, order.size(), &order);
+        events = order.size();
+    }
+    reader.Close();
+    writer->Close();
+
+    if (std::rename(partial.c_str(), job.output.c_str()) != 0) {
+        std::remove(partial.c_str());
+        error = "cannot rename " + partial;
+        return false;
+    }
+    return true;
+}
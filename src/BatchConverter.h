@@ -0,0 +1,75 @@
+#ifndef BATCHCONVERTER_H
+#define BATCHCONVERTER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include "EventFilter.h"
+
+// Settings for converting a directory of runs
+struct BatchSettings {
+    std::string format = "ttree";
+    int compression = 101;
+    unsigned threads = 1;           // Files converted concurrently, at most
+    size_t memoryBudget = 0;        // Shared by all running conversions
+    std::string tmpDir;             // Spill directory for oversized files
+    EventFilter filter;             // Events to convert
+};
+
+// Converts every .cap file of a directory into <name>.root in one process.
+// Files are converted on a pool of worker threads; a scheduler admits the
+// largest pending file whose estimated memory still fits the shared budget,
+// so many small files run side by side while a large one runs with fewer
+// neighbours.  A file too large for the whole budget is converted alone
+// through ExternalSorter.  Existing outputs are skipped, and outputs are
+// written under a temporary name and renamed when complete, so an
+// interrupted batch resumes where it stopped.
+class BatchConverter {
+public:
+    struct Job {
+        std::string input;
+        std::string output;
+        uint64_t bytes = 0;
+        size_t memory = 0;      // Reserved from the budget while running
+        bool external = false;  // Estimate exceeds the budget
+    };
+
+    explicit BatchConverter(const BatchSettings& settings);
+
+    // Queues the .cap files of inputDir; outputs go to outputDir (default:
+    // inputDir).  False if inputDir has no .cap files.
+    bool Plan(const std::string& inputDir, const std::string& outputDir = "");
+
+    // Converts all queued files; returns the number that failed
+    size_t Run();
+
+    const std::vector<Job>& Jobs() const { return jobs_; }
+    size_t NumSkipped() const { return skipped_; }
+    size_t NumConverted() const { return converted_; }
+
+    // Estimated peak memory of an in-memory conversion of a file this size
+    static size_t EstimateMemory(uint64_t fileBytes);
+
+private:
+    void Worker();
+    bool Convert(const Job& job, size_t& events, std::string& error);
+
+    BatchSettings settings_;
+    std::vector<Job> jobs_;
+    size_t skipped_ = 0;
+
+    // Scheduler state, guarded by mutex_
+    std::vector<bool> started_;
+    size_t pending_ = 0;
+    size_t running_ = 0;
+    size_t reserved_ = 0;
+    size_t converted_ = 0;
+    size_t failed_ = 0;
+    std::mutex mutex_;
+    std::condition_variable admitted_;
+};
+
+#endif
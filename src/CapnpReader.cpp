@@ -1,14 +1,159 @@
 #include "CapnpReader.h"
+#include "MessageIndex.h"
+#include "PacketTraits.h"
+#include "SampleCopy.h"
+#include <capnp/any.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// Updated once per packet, so relaxed atomics cost nothing measurable
+std::atomic<uint64_t> gTypePackets[CapnpReader::kNumTypes + 1];
+std::atomic<uint64_t> gTypeEvents[CapnpReader::kNumTypes + 1];
+
+const char* const kTypeNames[CapnpReader::kNumTypes] = {
+    "PlainData", "PsdData", "WaveData", "DualWaveData",
+    "FullData", "RawTimeData", "CrossData", "PsdWaveData"
+};
+
+// Copies a capnp waveform into the sample pool, in bulk from the list bytes
+uint16_t* CopyWaveform(capnp::List<int16_t>::Reader wave, uint16_t* trace) {
+    const size_t count = wave.size();
+    auto bytes = capnp::AnyList::Reader(wave).getRawBytes();
+    if (bytes.size() == count * sizeof(int16_t)) {
+        CopySamples(bytes.begin(), count, trace);
+        return trace + count;
+    }
+    // Not a plain Int16 list (e.g. a struct list read as Int16)
+    for (auto val : wave) {
+        *trace++ = val;
+    }
+    return trace;
+}
+
+// One decoder per packet struct.  The traits are compile-time constants, so
+// each instantiation's event loop only touches the fields its type has.
+template <typename Data>
+void DecodePacket(capnp::MessageReader& message, EventBatch& batch, const EventFilter* filter) {
+    using Traits = PacketTraits<Data>;
+
+    auto events = message.getRoot<Data>().getEvents();
+    const size_t first = batch.Size();
+
+    if constexpr (Traits::waveforms > 0) {
+        size_t samples = 0;
+        for (auto event : events) {
+            samples += event.getWaveform1().size();
+            if constexpr (Traits::waveforms > 1) {
+                samples += event.getWaveform2().size();
+            }
+        }
+        batch.Reserve(first + events.size(), batch.Samples.size() + samples);
+    } else {
+        batch.Reserve(first + events.size());
+    }
+
+    for (auto event : events) {
+        uint64_t ts = event.getTimestamp();
+        if (filter && !filter->Accepts(event.getBoard(), event.getChannel(), ts)) {
+            continue;
+        }
+        double fineTS = static_cast<double>(ts);
+        uint16_t chargeShort = 0;
+        uint32_t extras = 0;
+
+        if constexpr (Traits::fineTime) {
+            // A zero fine timestamp means none was recorded; keep TimeStamp
+            if (event.getFineTimestamp() != 0) {
+                fineTS = event.getFineTimestamp();
+            }
+        }
+        if constexpr (Traits::psd) {
+            chargeShort = static_cast<uint16_t>(event.getPsd() * 1000);
+        }
+        if constexpr (Traits::triggers) {
+            extras = (event.getGoodTrigger() ? EventBatch::kGoodTrigger : 0)
+                   | (event.getLostTrigger() ? EventBatch::kLostTrigger : 0);
+        }
+        batch.Add(event.getBoard(), event.getChannel(), ts, fineTS, event.getEnergy(),
+                  chargeShort, extras);
+
+        if constexpr (Traits::waveforms == 1) {
+            auto wave1 = event.getWaveform1();
+            CopyWaveform(wave1, batch.AddTraces(wave1.size()));
+        } else if constexpr (Traits::waveforms == 2) {
+            auto wave1 = event.getWaveform1();
+            auto wave2 = event.getWaveform2();
+            uint16_t* trace = batch.AddTraces(wave1.size(), wave2.size());
+            CopyWaveform(wave2, CopyWaveform(wave1, trace));
+        }
+    }
+}
+
+// Index summary of one packet: event count and time range, without
+// copying any payload
+template <typename Data>
+void DescribePacket(capnp::MessageReader& message, int type, MessageIndex& index, size_t i) {
+    auto events = message.getRoot<Data>().getEvents();
+    uint64_t minTs = events.size() > 0 ? events[0].getTimestamp() : 0;
+    uint64_t maxTs = minTs;
+    for (auto event : events) {
+        const uint64_t ts = event.getTimestamp();
+        minTs = std::min(minTs, ts);
+        maxTs = std::max(maxTs, ts);
+    }
+    index.Describe(i, type, events.size(), minTs, maxTs);
+}
+
+// Opens a reader on the raw bytes of one message and passes it to fn
+template <typename Fn>
+void WithMessage(const uint8_t* data, size_t size, bool packed, Fn&& fn) {
+    if (packed) {
+        kj::ArrayInputStream stream(kj::arrayPtr(data, size));
+        capnp::PackedMessageReader message(stream, {100000000, 64});
+        fn(message);
+    } else {
+        capnp::FlatArrayMessageReader message(
+            kj::arrayPtr(reinterpret_cast<const capnp::word*>(data), size / sizeof(capnp::word)),
+            {100000000, 64});
+        fn(message);
+    }
+}
+
+}  // namespace
 
 bool CapnpReader::Open(const std::string& filename) {
     fd_ = open(filename.c_str(), O_RDONLY);
     if (fd_ < 0) {
         return false;
     }
+    indexed_ = index_.Load(filename);
+    nextPacket_ = 0;
+
+    // Unpacked files are read in place from a private read-only mapping
+    struct stat st;
+    if (fstat(fd_, &st) == 0 && st.st_size > 0) {
+        size_t size = static_cast<size_t>(st.st_size);
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (addr != MAP_FAILED) {
+            if (IsUnpackedFraming(addr, size)) {
+                madvise(addr, size, MADV_SEQUENTIAL);
+                mapped_ = static_cast<const capnp::word*>(addr);
+                mappedSize_ = size;
+                mappedPos_ = 0;
+                return true;
+            }
+            munmap(addr, size);
+        }
+    }
 
     fdStream_ = std::make_unique<kj::FdInputStream>(fd_);
     bufferedStream_ = std::make_unique<kj::BufferedInputStreamWrapper>(*fdStream_);
@@ -18,6 +163,12 @@ bool CapnpReader::Open(const std::string& filename) {
 
 void CapnpReader::Close() {
     if (fd_ >= 0) {
+        if (mapped_) {
+            munmap(const_cast<capnp::word*>(mapped_), mappedSize_);
+            mapped_ = nullptr;
+            mappedSize_ = 0;
+            mappedPos_ = 0;
+        }
         bufferedStream_.reset();
         fdStream_.reset();
         close(fd_);
@@ -25,238 +176,310 @@ void CapnpReader::Close() {
     }
 }
 
+bool CapnpReader::SeekPacket(size_t i) {
+    if (!indexed_ || fd_ < 0 || i >= index_.Size()) {
+        return false;
+    }
+    const uint64_t offset = index_[i].offset;
+    nextPacket_ = i;
+    if (mapped_) {
+        mappedPos_ = offset;
+        return true;
+    }
+
+    // The buffered stream may hold bytes past the old position
+    bufferedStream_.reset();
+    fdStream_.reset();
+    if (lseek(fd_, static_cast<off_t>(offset), SEEK_SET) < 0) {
+        Close();
+        return false;
+    }
+    fdStream_ = std::make_unique<kj::FdInputStream>(fd_);
+    bufferedStream_ = std::make_unique<kj::BufferedInputStreamWrapper>(*fdStream_);
+    return true;
+}
+
+bool CapnpReader::BuildIndex(const std::string& filename, MessageIndex& index,
+                             unsigned threads) {
+    return ScanMessages(filename, index, threads,
+                        [&](unsigned, size_t i, capnp::MessageReader& message) {
+        const int type = message.getRoot<PlainData>().getType();
+        bool known = ForPacketType(type, [&](auto tag) {
+            DescribePacket<typename decltype(tag)::type>(message, type, index, i);
+        });
+        if (!known) {
+            // Unknown types decode to no events
+            index.Describe(i, type, 0, 0, 0);
+        }
+    });
+}
+
+bool CapnpReader::ScanMessages(const std::string& filename, MessageIndex& index,
+                               unsigned threads, const MessageVisitor& visit) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    const uint8_t* data = nullptr;
+    if (size > 0) {
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        data = static_cast<const uint8_t*>(addr);
+    }
+
+    // A current sidecar saves the boundary scan
+    bool bounded = index.Load(filename);
+    if (!bounded) {
+        bounded = index.Build(data, size, !IsUnpackedFraming(data, size));
+    }
+    if (!bounded) {
+        std::cerr << "Warning: " << filename << " ends with an incomplete message\n";
+    }
+    const bool packed = index.IsPacked();
+    std::atomic<bool> decoded(true);
+
+    // Each thread visits a contiguous range of about equal bytes
+    auto scan = [&](unsigned part, size_t first, size_t last) {
+        for (size_t i = first; i < last && decoded; i++) {
+            try {
+                WithMessage(data + index[i].offset, index[i].length, packed,
+                            [&](capnp::MessageReader& message) { visit(part, i, message); });
+            } catch (const std::exception& e) {
+                std::cerr << "Warning: cannot decode message " << i << ": " << e.what() << "\n";
+                decoded = false;
+            }
+        }
+    };
+    std::vector<size_t> bounds = index.Partition(threads > 0 ? threads : 1);
+    std::vector<std::thread> workers;
+    for (size_t part = 1; part + 1 < bounds.size(); part++) {
+        workers.emplace_back(scan, part, bounds[part], bounds[part + 1]);
+    }
+    scan(0, bounds[0], bounds[1]);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+    close(fd);
+    return bounded && decoded;
+}
+
 bool CapnpReader::HasNext() const {
+    if (mapped_) {
+        return mappedPos_ < mappedSize_;
+    }
     if (fd_ < 0 || !bufferedStream_) {
         return false;
     }
     return bufferedStream_->tryGetReadBuffer() != nullptr;
 }
 
+bool CapnpReader::IsUnpackedFraming(const void* data, size_t size) {
+    // Walk the segment tables from message to message.  A packed file
+    // essentially never tiles to exactly EOF this way.
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t pos = 0;
+
+    if (size == 0 || size % sizeof(capnp::word) != 0) {
+        return false;
+    }
+    while (pos < size) {
+        size_t length = MessageIndex::UnpackedMessageLength(bytes + pos, size - pos);
+        if (length == 0) {
+            return false;
+        }
+        pos += length;
+    }
+    return true;
+}
+
+bool CapnpReader::IsUnpackedFile(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool unpacked = false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        size_t size = static_cast<size_t>(st.st_size);
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            unpacked = IsUnpackedFraming(addr, size);
+            munmap(addr, size);
+        }
+    }
+    close(fd);
+
+    return unpacked;
+}
+
+bool CapnpReader::NextMessage(const std::function<void(capnp::MessageReader&)>& fn) {
+    if (mapped_) {
+        if (mappedPos_ >= mappedSize_) {
+            return false;
+        }
+        kj::ArrayPtr<const capnp::word> words(mapped_ + mappedPos_ / sizeof(capnp::word),
+                                              (mappedSize_ - mappedPos_) / sizeof(capnp::word));
+        capnp::FlatArrayMessageReader message(words, {100000000, 64});
+        mappedPos_ = (message.getEnd() - mapped_) * sizeof(capnp::word);
+        fn(message);
+        return true;
+    }
+
+    if (fd_ < 0 || !bufferedStream_ || bufferedStream_->tryGetReadBuffer() == nullptr) {
+        return false;
+    }
+    capnp::PackedMessageReader message(*bufferedStream_, {100000000, 64});
+    fn(message);
+    return true;
+}
+
 std::vector<std::unique_ptr<TreeData>> CapnpReader::ReadNextPacket() {
     std::vector<std::unique_ptr<TreeData>> results;
 
-    if (fd_ < 0 || !bufferedStream_) {
-        return results;
+    EventBatch batch;
+    ReadNextPacket(batch);
+
+    results.reserve(batch.Size());
+    for (size_t i = 0; i < batch.Size(); i++) {
+        auto data = std::make_unique<TreeData>();
+        batch.Get(i, *data);
+        results.push_back(std::move(data));
     }
 
-    try {
-        if (bufferedStream_->tryGetReadBuffer() == nullptr) {
+    return results;
+}
+
+size_t CapnpReader::ReadNextPacket(EventBatch& batch) {
+    const size_t first = batch.Size();
+
+    // The index tells which packets hold no event of the time range
+    if (indexed_ && filter_.HasTimeRange() && fd_ >= 0) {
+        size_t next = nextPacket_;
+        while (next < index_.Size()
+               && !filter_.OverlapsTime(index_[next].minTimeStamp, index_[next].maxTimeStamp)) {
+            next++;
+        }
+        if (next == index_.Size()) {
             Close();
-            return results;
+            return 0;
         }
+        if (next != nextPacket_ && !SeekPacket(next)) {
+            return 0;
+        }
+    }
 
-        capnp::PackedMessageReader message(*bufferedStream_, {100000000, 64});
-
-        // First read as PlainData to get the type
-        auto plainData = message.getRoot<PlainData>();
-        int evtType = plainData.getType();
-
-        // Process based on type
-        switch (evtType) {
-            case 0: {  // PlainData
-                auto events = plainData.getEvents();
-                results.reserve(events.size());
-                for (auto event : events) {
-                    auto data = std::make_unique<TreeData>();
-                    data->Mod = event.getBoard();
-                    data->Ch = event.getChannel();
-                    data->TimeStamp = event.getTimestamp();
-                    data->ChargeLong = event.getEnergy();
-                    data->ChargeShort = 0;
-                    data->Extras = 0;
-                    data->RecordLength = 0;
-                    data->FineTS = static_cast<double>(data->TimeStamp);
-                    results.push_back(std::move(data));
-                }
-                break;
-            }
-            case 1: {  // PsdData
-                auto psdData = message.getRoot<PsdData>();
-                auto events = psdData.getEvents();
-                results.reserve(events.size());
-                for (auto event : events) {
-                    auto data = std::make_unique<TreeData>();
-                    data->Mod = event.getBoard();
-                    data->Ch = event.getChannel();
-                    data->ChargeLong = event.getEnergy();
-                    data->TimeStamp = event.getTimestamp();
-                    data->ChargeShort = static_cast<uint16_t>(event.getPsd() * 1000);
-                    data->FineTS = static_cast<double>(data->TimeStamp);
-                    data->Extras = 0;
-                    data->RecordLength = 0;
-                    results.push_back(std::move(data));
-                }
-                break;
-            }
-            case 2: {  // WaveData
-                auto waveData = message.getRoot<WaveData>();
-                auto events = waveData.getEvents();
-                results.reserve(events.size());
-                for (auto event : events) {
-                    auto data = std::make_unique<TreeData>();
-                    data->Mod = event.getBoard();
-                    data->Ch = event.getChannel();
-                    data->ChargeLong = event.getEnergy();
-                    data->TimeStamp = event.getTimestamp();
-                    data->ChargeShort = 0;
-                    data->FineTS = static_cast<double>(data->TimeStamp);
-                    data->Extras = 0;
-
-                    auto wave = event.getWaveform1();
-                    data->RecordLength = wave.size();
-                    data->Trace1.reserve(data->RecordLength);
-                    for (auto val : wave) {
-                        data->Trace1.push_back(val);
-                    }
-                    results.push_back(std::move(data));
-                }
-                break;
-            }
-            case 3: {  // DualWaveData
-                auto dwData = message.getRoot<DualWaveData>();
-                auto events = dwData.getEvents();
-                results.reserve(events.size());
-                for (auto event : events) {
-                    auto data = std::make_unique<TreeData>();
-                    data->Mod = event.getBoard();
-                    data->Ch = event.getChannel();
-                    data->ChargeLong = event.getEnergy();
-                    data->TimeStamp = event.getTimestamp();
-                    data->ChargeShort = 0;
-                    data->FineTS = static_cast<double>(data->TimeStamp);
-                    data->Extras = 0;
-
-                    auto wave1 = event.getWaveform1();
-                    auto wave2 = event.getWaveform2();
-                    data->RecordLength = wave1.size();
-                    data->Trace1.reserve(data->RecordLength);
-                    data->Trace2.reserve(data->RecordLength);
-                    for (auto val : wave1) {
-                        data->Trace1.push_back(val);
-                    }
-                    for (auto val : wave2) {
-                        data->Trace2.push_back(val);
-                    }
-                    results.push_back(std::move(data));
-                }
-                break;
-            }
-            case 4: {  // FullData
-                auto fullData = message.getRoot<FullData>();
-                auto events = fullData.getEvents();
-                results.reserve(events.size());
-                for (auto event : events) {
-                    auto data = std::make_unique<TreeData>();
-                    data->Mod = event.getBoard();
-                    data->Ch = event.getChannel();
-                    data->ChargeLong = event.getEnergy();
-                    data->TimeStamp = event.getTimestamp();
-                    data->ChargeShort = static_cast<uint16_t>(event.getPsd() * 1000);
-                    data->FineTS = static_cast<double>(data->TimeStamp);
-                    data->Extras = 0;
-
-                    auto wave1 = event.getWaveform1();
-                    auto wave2 = event.getWaveform2();
-                    data->RecordLength = wave1.size();
-                    data->Trace1.reserve(data->RecordLength);
-                    data->Trace2.reserve(data->RecordLength);
-                    for (auto val : wave1) {
-                        data->Trace1.push_back(val);
-                    }
-                    for (auto val : wave2) {
-                        data->Trace2.push_back(val);
-                    }
-                    results.push_back(std::move(data));
-                }
-                break;
-            }
-            case 5: {  // RawTimeData
-                auto rtData = message.getRoot<RawTimeData>();
-                auto events = rtData.getEvents();
-                results.reserve(events.size());
-                for (auto event : events) {
-                    auto data = std::make_unique<TreeData>();
-                    data->Mod = event.getBoard();
-                    data->Ch = event.getChannel();
-                    data->ChargeLong = event.getEnergy();
-                    data->TimeStamp = event.getTimestamp();
-                    data->ChargeShort = 0;
-                    data->FineTS = event.getFineTimestamp();
-                    // If FineTS is empty (0), use TimeStamp as double
-                    if (data->FineTS == 0.0) {
-                        data->FineTS = static_cast<double>(data->TimeStamp);
-                    }
-                    data->Extras = 0;
-                    data->RecordLength = 0;
-                    results.push_back(std::move(data));
-                }
-                break;
-            }
-            default:
-                std::cerr << "Warning: Unknown event type " << evtType << "\n";
-                break;
+    const EventFilter* filter = filter_.IsActive() ? &filter_ : nullptr;
+    try {
+        bool more = NextMessage([&](capnp::MessageReader& message) {
+            nextPacket_++;
+            DecodeMessage(message, batch, filter);
+        });
+        if (!more) {
+            Close();
         }
     } catch (const std::exception& e) {
         // EOF or error
         Close();
     }
 
-    return results;
+    return batch.Size() - first;
+}
+
+size_t CapnpReader::DecodeBytes(const void* data, size_t size, bool packed, EventBatch& batch,
+                                const EventFilter* filter, int* type) {
+    if (packed) {
+        kj::ArrayInputStream stream(kj::arrayPtr(static_cast<const kj::byte*>(data), size));
+        capnp::PackedMessageReader message(stream, {100000000, 64});
+        return DecodeMessage(message, batch, filter, type);
+    }
+
+    // Unpacked messages are word aligned in a mapped file and read in place
+    capnp::FlatArrayMessageReader message(
+        kj::arrayPtr(static_cast<const capnp::word*>(data), size / sizeof(capnp::word)),
+        {100000000, 64});
+    return DecodeMessage(message, batch, filter, type);
+}
+
+size_t CapnpReader::DecodeMessage(capnp::MessageReader& message, EventBatch& batch,
+                                  const EventFilter* filter, int* type) {
+    const size_t first = batch.Size();
+
+    // Every *Data struct starts with the type field, so read it as PlainData
+    int evtType = message.getRoot<PlainData>().getType();
+    if (type) {
+        *type = evtType;
+    }
+
+    bool known = ForPacketType(evtType, [&](auto tag) {
+        DecodePacket<typename decltype(tag)::type>(message, batch, filter);
+    });
+    if (!known) {
+        std::cerr << "Warning: Unknown event type " << evtType << "\n";
+    }
+
+    const size_t added = batch.Size() - first;
+    const int slot = evtType < kNumTypes ? evtType : kNumTypes;
+    gTypePackets[slot].fetch_add(1, std::memory_order_relaxed);
+    gTypeEvents[slot].fetch_add(added, std::memory_order_relaxed);
+
+    return added;
+}
+
+const char* CapnpReader::TypeName(int type) {
+    return type >= 0 && type < kNumTypes ? kTypeNames[type] : "Unknown";
+}
+
+std::vector<TypeCount> CapnpReader::DecodedTypeCounts() {
+    std::vector<TypeCount> counts(kNumTypes + 1);
+    for (int type = 0; type <= kNumTypes; type++) {
+        counts[type].packets = gTypePackets[type].load(std::memory_order_relaxed);
+        counts[type].events = gTypeEvents[type].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+void CapnpReader::ResetTypeCounts() {
+    for (int type = 0; type <= kNumTypes; type++) {
+        gTypePackets[type].store(0, std::memory_order_relaxed);
+        gTypeEvents[type].store(0, std::memory_order_relaxed);
+    }
 }
 
 size_t CapnpReader::CountTotalEvents() {
-    if (fd_ < 0 || !bufferedStream_) {
-        return 0;
+    if (indexed_) {
+        return index_.TotalEvents();
     }
 
     size_t totalEvents = 0;
 
-    while (bufferedStream_->tryGetReadBuffer() != nullptr) {
-        try {
-            capnp::PackedMessageReader message(*bufferedStream_, {100000000, 64});
-
-            // Read as PlainData to get the type
-            auto plainData = message.getRoot<PlainData>();
-            int evtType = plainData.getType();
-
-            // Count events based on type
-            switch (evtType) {
-                case 0: {  // PlainData
-                    totalEvents += plainData.getEvents().size();
-                    break;
-                }
-                case 1: {  // PsdData
-                    auto psdData = message.getRoot<PsdData>();
-                    totalEvents += psdData.getEvents().size();
-                    break;
-                }
-                case 2: {  // WaveData
-                    auto waveData = message.getRoot<WaveData>();
-                    totalEvents += waveData.getEvents().size();
-                    break;
-                }
-                case 3: {  // DualWaveData
-                    auto dwData = message.getRoot<DualWaveData>();
-                    totalEvents += dwData.getEvents().size();
-                    break;
-                }
-                case 4: {  // FullData
-                    auto fullData = message.getRoot<FullData>();
-                    totalEvents += fullData.getEvents().size();
-                    break;
-                }
-                case 5: {  // RawTimeData
-                    auto rtData = message.getRoot<RawTimeData>();
-                    totalEvents += rtData.getEvents().size();
-                    break;
-                }
-                default:
-                    break;
-            }
-        } catch (const std::exception& e) {
-            // EOF or error
-            break;
+    // Every *Data struct has the same layout, so the event list can be sized
+    // through PlainData whatever the type
+    auto count = [&](capnp::MessageReader& message) {
+        auto plainData = message.getRoot<PlainData>();
+        if (plainData.getType() < kNumTypes) {
+            totalEvents += plainData.getEvents().size();
+        }
+    };
+
+    try {
+        while (NextMessage(count)) {
         }
+    } catch (const std::exception& e) {
+        // EOF or error
     }
 
     // Close and reopen to reset stream position
@@ -265,18 +488,22 @@ size_t CapnpReader::CountTotalEvents() {
     return totalEvents;
 }
 
-void CapnpReader::DumpPacket(int packetNum, bool verbose) {
+size_t CapnpReader::DumpPacket(int packetNum, bool verbose) {
     // Simplified dump - just show summary
-    auto events = ReadNextPacket();
-    if (events.empty()) {
+    EventBatch events;
+    const size_t before = nextPacket_;
+    ReadNextPacket(events);
+    // Zero-event packets are valid and dumped like any other; only a read
+    // that consumed no message and closed the reader is the end
+    if (nextPacket_ == before && !HasNext()) {
         std::cout << "End of file\n";
-        return;
+        return 0;
     }
 
     std::cout << "\n=== Packet " << packetNum << " ===\n";
-    std::cout << "Events: " << events.size() << "\n";
+    std::cout << "Events: " << events.Size() << "\n";
 
-    if (verbose && !events.empty()) {
+    if (verbose) {
         std::cout << "\n" << std::setw(6) << "Index"
                   << std::setw(6) << "Mod"
                   << std::setw(6) << "Ch"
@@ -284,15 +511,18 @@ void CapnpReader::DumpPacket(int packetNum, bool verbose) {
                   << std::setw(16) << "Timestamp\n";
         std::cout << std::string(44, '-') << "\n";
 
-        for (size_t i = 0; i < std::min(events.size(), size_t(10)); i++) {
+        for (size_t i = 0; i < std::min(events.Size(), size_t(10)); i++) {
+            EventView event = events.View(i);
             std::cout << std::setw(6) << i
-                      << std::setw(6) << (int)events[i]->Mod
-                      << std::setw(6) << (int)events[i]->Ch
-                      << std::setw(10) << events[i]->ChargeLong
-                      << std::setw(16) << events[i]->TimeStamp << "\n";
+                      << std::setw(6) << (int)event.Mod
+                      << std::setw(6) << (int)event.Ch
+                      << std::setw(10) << event.ChargeLong
+                      << std::setw(16) << event.TimeStamp << "\n";
         }
-        if (events.size() > 10) {
-            std::cout << "... (" << (events.size() - 10) << " more events)\n";
+        if (events.Size() > 10) {
+            std::cout << "... (" << (events.Size() - 10) << " more events)\n";
         }
     }
+
+    return events.Size();
 }
@@ -4,13 +4,33 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
 #include <capnp/message.h>
 #include <capnp/serialize.h>
 #include <capnp/serialize-packed.h>
 #include <kj/io.h>
 #include "eventProto.capnp.h"
 #include "../TreeData.h"
+#include "EventBatch.h"
+#include "MessageIndex.h"
+#include "EventFilter.h"
 
+// Packets and events decoded for one packet type
+struct TypeCount {
+    uint64_t packets;
+    uint64_t events;
+};
+
+// Reads .cap files one message (packet) at a time.  Packed files are
+// streamed through PackedMessageReader.  Files in the unpacked framing are
+// detected on Open(), memory-mapped and read in place with
+// FlatArrayMessageReader, without copying the event lists.
+//
+// When a current .capidx sidecar exists (see BuildIndex) Open() loads it,
+// which gives the event total without a scan and lets SeekPacket() jump to
+// any packet.  An EventFilter set with SetFilter() drops events while they
+// are decoded, and with an index packets outside its time range are skipped
+// unread.
 class CapnpReader {
 public:
     CapnpReader() = default;
@@ -20,13 +40,72 @@ public:
     void Close();
     bool HasNext() const;
     std::vector<std::unique_ptr<TreeData>> ReadNextPacket();
-    void DumpPacket(int packetNum, bool verbose = false);
-    size_t CountTotalEvents();  // Count total events in file
+    size_t ReadNextPacket(EventBatch& batch);  // Appends; returns events added
+    size_t DumpPacket(int packetNum, bool verbose = false);  // Returns events shown
+    // Position of the next packet to read; unchanged by a read that hit the end
+    size_t NextPacket() const { return nextPacket_; }
+    // Count total events in file.  Without a sidecar index this reads the
+    // file and closes the reader.
+    size_t CountTotalEvents();
+    bool IsMapped() const { return mapped_ != nullptr; }
+
+    void SetFilter(const EventFilter& filter) { filter_ = filter; }
+
+    bool HasIndex() const { return indexed_; }
+    const MessageIndex& Index() const { return index_; }
+    // Positions the reader at packet i of the sidecar index; false without
+    // an index, out of range or after the reader was closed
+    bool SeekPacket(size_t i);
+
+    // Indexes filename and describes every message (type, event count,
+    // time range), decoding on up to threads threads.  False if the file
+    // cannot be read, ends in an incomplete message or has a message that
+    // cannot be decoded; such an index should not be saved.
+    static bool BuildIndex(const std::string& filename, MessageIndex& index,
+                           unsigned threads = 1);
+
+    // Calls visit(part, i, message) for every message i of filename.  The
+    // messages are split into at most threads byte-balanced ranges (parts)
+    // visited concurrently, each in file order; a current sidecar index
+    // replaces the boundary scan.  Returns false as BuildIndex does.
+    using MessageVisitor = std::function<void(unsigned part, size_t i, capnp::MessageReader&)>;
+    static bool ScanMessages(const std::string& filename, MessageIndex& index, unsigned threads,
+                             const MessageVisitor& visit);
+
+    // True if data is a sequence of complete unpacked messages
+    static bool IsUnpackedFraming(const void* data, size_t size);
+    static bool IsUnpackedFile(const std::string& filename);
+
+    // Decodes one message into batch; returns events added and, if type is
+    // given, stores the packet type there.  Events rejected by filter are
+    // skipped.  DecodeBytes takes the raw bytes of a single message as found
+    // in the file.
+    static size_t DecodeMessage(capnp::MessageReader& message, EventBatch& batch,
+                                const EventFilter* filter = nullptr, int* type = nullptr);
+    static size_t DecodeBytes(const void* data, size_t size, bool packed, EventBatch& batch,
+                              const EventFilter* filter = nullptr, int* type = nullptr);
+
+    // Packet types 0-7; the last slot of DecodedTypeCounts() collects unknown
+    // types.  The counts cover every DecodeMessage call in the process, on
+    // any thread.
+    static const int kNumTypes = 8;
+    static const char* TypeName(int type);
+    static std::vector<TypeCount> DecodedTypeCounts();
+    static void ResetTypeCounts();
 
 private:
+    bool NextMessage(const std::function<void(capnp::MessageReader&)>& fn);
+
     int fd_ = -1;
+    const capnp::word* mapped_ = nullptr;
+    size_t mappedSize_ = 0;
+    size_t mappedPos_ = 0;
     std::unique_ptr<kj::FdInputStream> fdStream_;
     std::unique_ptr<kj::BufferedInputStreamWrapper> bufferedStream_;
+    MessageIndex index_;
+    bool indexed_ = false;
+    size_t nextPacket_ = 0;     // Packet NextMessage() reads next
+    EventFilter filter_;
 };
 
 #endif
@@ -0,0 +1,212 @@
+#include "ConversionStats.h"
+#include "CapnpReader.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+namespace {
+
+double Seconds(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+double PerSecond(uint64_t count, double seconds) {
+    return seconds > 0 ? count / seconds : 0.0;
+}
+
+double Megabytes(uint64_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+std::string JsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (static_cast<unsigned char>(c) < 0x20) {
+            // Control characters are legal in file names but not in JSON
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+            quoted += escaped;
+            continue;
+        }
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+}  // namespace
+
+ConversionStats::ConversionStats()
+    : start_(std::chrono::steady_clock::now()), stageStart_(start_) {
+}
+
+void ConversionStats::Begin(const std::string& stage) {
+    ResetPeakRss();
+    StageStats stats;
+    stats.name = stage;
+    stages_.push_back(stats);
+    stageStart_ = std::chrono::steady_clock::now();
+    stageCpuStart_ = CpuSeconds();
+}
+
+void ConversionStats::End(uint64_t events, uint64_t bytesIn, uint64_t bytesOut) {
+    if (stages_.empty()) {
+        return;
+    }
+    StageStats& stats = stages_.back();
+    stats.wallSeconds = Seconds(std::chrono::steady_clock::now() - stageStart_);
+    stats.cpuSeconds = CpuSeconds() - stageCpuStart_;
+    stats.events = events;
+    stats.bytesIn = bytesIn;
+    stats.bytesOut = bytesOut;
+    stats.peakRssBytes = PeakRssBytes();
+}
+
+void ConversionStats::SetCounter(const std::string& name, uint64_t value) {
+    for (auto& counter : counters_) {
+        if (counter.first == name) {
+            counter.second = value;
+            return;
+        }
+    }
+    counters_.emplace_back(name, value);
+}
+
+double ConversionStats::CpuSeconds() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+uint64_t ConversionStats::PeakRssBytes() {
+    // VmHWM follows resets through clear_refs, ru_maxrss never goes down
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stoull(line.substr(6)) * 1024;
+        }
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+void ConversionStats::ResetPeakRss() {
+    // Linux >= 4.0 resets the high-water mark to the current RSS
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs) {
+        clearRefs << "5";
+    }
+}
+
+uint64_t ConversionStats::FileBytes(const std::string& filename) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return 0;
+    }
+    return st.st_size;
+}
+
+void ConversionStats::Print(std::ostream& out) const {
+    std::ios_base::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(2);
+
+    out << "\nStage statistics:\n";
+    out << std::left << std::setw(8) << "Stage" << std::right
+        << std::setw(10) << "Wall[s]" << std::setw(10) << "CPU[s]"
+        << std::setw(13) << "Events" << std::setw(13) << "Events/s"
+        << std::setw(10) << "In[MB]" << std::setw(10) << "Out[MB]"
+        << std::setw(10) << "RSS[MB]" << "\n";
+    out << std::string(84, '-') << "\n";
+    for (const StageStats& stage : stages_) {
+        out << std::left << std::setw(8) << stage.name << std::right
+            << std::setw(10) << stage.wallSeconds << std::setw(10) << stage.cpuSeconds
+            << std::setw(13) << stage.events
+            << std::setw(13) << std::setprecision(0) << PerSecond(stage.events, stage.wallSeconds)
+            << std::setprecision(2)
+            << std::setw(10) << Megabytes(stage.bytesIn) << std::setw(10) << Megabytes(stage.bytesOut)
+            << std::setw(10) << Megabytes(stage.peakRssBytes) << "\n";
+    }
+    out << "Total wall time " << Seconds(std::chrono::steady_clock::now() - start_)
+        << " s, CPU time " << CpuSeconds() << " s\n";
+    for (const auto& counter : counters_) {
+        out << counter.first << ": " << counter.second << "\n";
+    }
+
+    out << "\nEvent types:\n";
+    std::vector<TypeCount> counts = CapnpReader::DecodedTypeCounts();
+    for (int type = 0; type <= CapnpReader::kNumTypes; type++) {
+        if (counts[type].packets == 0) {
+            continue;
+        }
+        out << std::left << std::setw(14) << CapnpReader::TypeName(type) << std::right
+            << std::setw(10) << counts[type].packets << " packets"
+            << std::setw(14) << counts[type].events << " events\n";
+    }
+
+    out.flags(flags);
+}
+
+bool ConversionStats::WriteJson(const std::string& filename, const std::string& inputFile,
+                                const std::string& outputFile) const {
+    std::ofstream out(filename);
+    if (!out) {
+        return false;
+    }
+    out << std::setprecision(6) << std::fixed;
+
+    out << "{\n";
+    out << "  \"input\": " << JsonString(inputFile) << ",\n";
+    out << "  \"output\": " << JsonString(outputFile) << ",\n";
+    out << "  \"wall_seconds\": " << Seconds(std::chrono::steady_clock::now() - start_) << ",\n";
+    out << "  \"cpu_seconds\": " << CpuSeconds() << ",\n";
+    out << "  \"stages\": [";
+    for (size_t i = 0; i < stages_.size(); i++) {
+        const StageStats& stage = stages_[i];
+        out << (i ? ",\n" : "\n")
+            << "    {\"name\": " << JsonString(stage.name)
+            << ", \"wall_seconds\": " << stage.wallSeconds
+            << ", \"cpu_seconds\": " << stage.cpuSeconds
+            << ", \"events\": " << stage.events
+            << ", \"events_per_second\": " << PerSecond(stage.events, stage.wallSeconds)
+            << ", \"bytes_in\": " << stage.bytesIn
+            << ", \"bytes_out\": " << stage.bytesOut
+            << ", \"peak_rss_bytes\": " << stage.peakRssBytes << "}";
+    }
+    out << "\n  ],\n";
+
+    out << "  \"counters\": {";
+    for (size_t i = 0; i < counters_.size(); i++) {
+        out << (i ? ", " : "") << JsonString(counters_[i].first) << ": " << counters_[i].second;
+    }
+    out << "},\n";
+
+    out << "  \"event_types\": [";
+    std::vector<TypeCount> counts = CapnpReader::DecodedTypeCounts();
+    bool first = true;
+    for (int type = 0; type <= CapnpReader::kNumTypes; type++) {
+        if (counts[type].packets == 0) {
+            continue;
+        }
+        out << (first ? "\n" : ",\n")
+            << "    {\"type\": " << (type < CapnpReader::kNumTypes ? std::to_string(type) : "null")
+            << ", \"name\": " << JsonString(CapnpReader::TypeName(type))
+            << ", \"packets\": " << counts[type].packets
+            << ", \"events\": " << counts[type].events << "}";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,56 @@
+#ifndef CONVERSIONSTATS_H
+#define CONVERSIONSTATS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+// Resources used by one conversion stage.  CPU time covers all threads of
+// the process; peak RSS is the high-water mark reached during the stage.
+struct StageStats {
+    std::string name;
+    double wallSeconds = 0;
+    double cpuSeconds = 0;
+    uint64_t events = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t peakRssBytes = 0;
+};
+
+// Times the stages of a conversion (read, sort, write, ...) and reports them
+// together with the per-type packet and event counts from CapnpReader.
+class ConversionStats {
+public:
+    ConversionStats();
+
+    // Starts a stage; the peak RSS mark is reset where the kernel allows it
+    void Begin(const std::string& stage);
+    void End(uint64_t events, uint64_t bytesIn = 0, uint64_t bytesOut = 0);
+
+    const std::vector<StageStats>& Stages() const { return stages_; }
+
+    // Named totals reported after the stages, e.g. window violations
+    void SetCounter(const std::string& name, uint64_t value);
+
+    void Print(std::ostream& out) const;
+    bool WriteJson(const std::string& filename, const std::string& inputFile,
+                   const std::string& outputFile) const;
+
+    static double CpuSeconds();
+    static uint64_t PeakRssBytes();
+    static uint64_t FileBytes(const std::string& filename);  // 0 if missing
+
+private:
+    static void ResetPeakRss();
+
+    std::vector<StageStats> stages_;
+    std::vector<std::pair<std::string, uint64_t>> counters_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point stageStart_;
+    double stageCpuStart_ = 0;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "EventBatch.h"
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <thread>
+
+namespace {
+
+// reserve() with geometric growth, so reserving per packet stays amortized
+template <typename T>
+void Grow(std::vector<T>& column, size_t n) {
+    if (n > column.capacity()) {
+        column.reserve(std::max(n, 2 * column.capacity()));
+    }
+}
+
+template <typename T>
+size_t ColumnBytes(const std::vector<T>& column) {
+    return column.capacity() * sizeof(T);
+}
+
+// 11-bit digits: 2048 buckets per pass fit in L1, and the 40-odd bits in
+// which a run's timestamps differ take four passes
+const int kRadixBits = 11;
+const size_t kRadixBuckets = size_t(1) << kRadixBits;
+
+struct KeyIndex {
+    uint64_t key;
+    uint64_t index;
+};
+
+// Runs fn(0) ... fn(threads - 1), on threads when there is more than one
+void ForEachThread(unsigned threads, const std::function<void(unsigned)>& fn) {
+    if (threads <= 1) {
+        fn(0);
+        return;
+    }
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back(fn, t);
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+}  // namespace
+
+void EventBatch::Clear() {
+    Mod.clear();
+    Ch.clear();
+    TimeStamp.clear();
+    FineTS.clear();
+    ChargeLong.clear();
+    ChargeShort.clear();
+    Extras.clear();
+    RecordLength.clear();
+    TraceOffset.clear();
+    Trace2Length.clear();
+    Samples.clear();
+    hasTraces_ = false;
+}
+
+void EventBatch::Reserve(size_t events, size_t samples) {
+    Grow(Mod, events);
+    Grow(Ch, events);
+    Grow(TimeStamp, events);
+    Grow(FineTS, events);
+    Grow(ChargeLong, events);
+    Grow(ChargeShort, events);
+    Grow(Extras, events);
+    Grow(RecordLength, events);
+    if (samples > 0) {
+        Grow(TraceOffset, events);
+        Grow(Trace2Length, events);
+        Grow(Samples, samples);
+    }
+}
+
+size_t EventBatch::Add(uint8_t mod, uint8_t ch, uint64_t timeStamp, double fineTS,
+                       uint16_t chargeLong, uint16_t chargeShort, uint32_t extras) {
+    Mod.push_back(mod);
+    Ch.push_back(ch);
+    TimeStamp.push_back(timeStamp);
+    FineTS.push_back(fineTS);
+    ChargeLong.push_back(chargeLong);
+    ChargeShort.push_back(chargeShort);
+    Extras.push_back(extras);
+    RecordLength.push_back(0);
+    if (hasTraces_) {
+        TraceOffset.push_back(Samples.size());
+        Trace2Length.push_back(0);
+    }
+    return TimeStamp.size() - 1;
+}
+
+void EventBatch::EnableTraces() {
+    // Events added before the first waveform get empty traces
+    TraceOffset.assign(Size(), Samples.size());
+    Trace2Length.assign(Size(), 0);
+    hasTraces_ = true;
+}
+
+uint16_t* EventBatch::AddTraces(uint32_t length1, uint32_t length2) {
+    if (!hasTraces_) {
+        EnableTraces();
+    }
+
+    size_t offset = Samples.size();
+    Samples.resize(offset + length1 + length2);
+    TraceOffset.back() = offset;
+    Trace2Length.back() = length2;
+    RecordLength.back() = length1;
+    return Samples.data() + offset;
+}
+
+void EventBatch::Add(const TreeData& data) {
+    Add(data.Mod, data.Ch, data.TimeStamp, data.FineTS, data.ChargeLong, data.ChargeShort,
+        data.Extras);
+    if (data.RecordLength == 0 && data.Trace2.empty()) {
+        return;
+    }
+
+    // Trace1 is stored as RecordLength samples, zero-padded if short
+    uint16_t* dst = AddTraces(data.RecordLength, data.Trace2.size());
+    size_t n1 = std::min<size_t>(data.RecordLength, data.Trace1.size());
+    std::copy(data.Trace1.begin(), data.Trace1.begin() + n1, dst);
+    std::copy(data.Trace2.begin(), data.Trace2.end(), dst + data.RecordLength);
+}
+
+void EventBatch::Append(const EventBatch& other, size_t i) {
+    Add(other.Mod[i], other.Ch[i], other.TimeStamp[i], other.FineTS[i],
+        other.ChargeLong[i], other.ChargeShort[i], other.Extras[i]);
+
+    uint32_t length1 = other.RecordLength[i];
+    uint32_t length2 = other.Trace2Size(i);
+    if (length1 == 0 && length2 == 0) {
+        return;
+    }
+    uint16_t* dst = AddTraces(length1, length2);
+    const uint16_t* src = other.Trace1(i);
+    std::copy(src, src + length1 + length2, dst);
+}
+
+void EventBatch::Append(const EventBatch& other) {
+    // Column-wise bulk copy; only the trace offsets need rebasing
+    const size_t first = Size();
+    const size_t base = Samples.size();
+    Reserve(first + other.Size(), other.HasTraces() ? base + other.Samples.size() : 0);
+
+    Mod.insert(Mod.end(), other.Mod.begin(), other.Mod.end());
+    Ch.insert(Ch.end(), other.Ch.begin(), other.Ch.end());
+    TimeStamp.insert(TimeStamp.end(), other.TimeStamp.begin(), other.TimeStamp.end());
+    FineTS.insert(FineTS.end(), other.FineTS.begin(), other.FineTS.end());
+    ChargeLong.insert(ChargeLong.end(), other.ChargeLong.begin(), other.ChargeLong.end());
+    ChargeShort.insert(ChargeShort.end(), other.ChargeShort.begin(), other.ChargeShort.end());
+    Extras.insert(Extras.end(), other.Extras.begin(), other.Extras.end());
+    RecordLength.insert(RecordLength.end(), other.RecordLength.begin(), other.RecordLength.end());
+
+    if (other.HasTraces()) {
+        if (!hasTraces_) {
+            TraceOffset.assign(first, base);
+            Trace2Length.assign(first, 0);
+            hasTraces_ = true;
+        }
+        for (uint64_t offset : other.TraceOffset) {
+            TraceOffset.push_back(base + offset);
+        }
+        Trace2Length.insert(Trace2Length.end(), other.Trace2Length.begin(), other.Trace2Length.end());
+        Samples.insert(Samples.end(), other.Samples.begin(), other.Samples.end());
+    } else if (hasTraces_) {
+        TraceOffset.resize(Size(), base);
+        Trace2Length.resize(Size(), 0);
+    }
+}
+
+void EventBatch::Get(size_t i, TreeData& data) const {
+    data.Mod = Mod[i];
+    data.Ch = Ch[i];
+    data.TimeStamp = TimeStamp[i];
+    data.FineTS = FineTS[i];
+    data.ChargeLong = ChargeLong[i];
+    data.ChargeShort = ChargeShort[i];
+    data.Extras = Extras[i];
+    data.RecordLength = RecordLength[i];
+
+    const uint16_t* trace1 = Trace1(i);
+    if (trace1) {
+        data.Trace1.assign(trace1, trace1 + RecordLength[i]);
+        data.Trace2.assign(trace1 + RecordLength[i], trace1 + RecordLength[i] + Trace2Length[i]);
+    } else {
+        data.Trace1.clear();
+        data.Trace2.clear();
+    }
+    data.DTrace1.clear();
+    data.DTrace2.clear();
+}
+
+EventView EventBatch::View(size_t i) const {
+    return {Mod[i], Ch[i], TimeStamp[i], FineTS[i], ChargeLong[i], ChargeShort[i],
+            Extras[i], RecordLength[i], Trace1(i), Trace2(i), Trace2Size(i)};
+}
+
+const uint16_t* EventBatch::Trace1(size_t i) const {
+    return hasTraces_ ? Samples.data() + TraceOffset[i] : nullptr;
+}
+
+const uint16_t* EventBatch::Trace2(size_t i) const {
+    return hasTraces_ ? Samples.data() + TraceOffset[i] + RecordLength[i] : nullptr;
+}
+
+std::vector<size_t> EventBatch::StableTimeOrder() const {
+    std::vector<size_t> order(Size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [this](size_t a, size_t b) {
+                         return TimeStamp[a] < TimeStamp[b];
+                     });
+    return order;
+}
+
+std::vector<size_t> EventBatch::RadixTimeOrder(unsigned threads) const {
+    const size_t n = Size();
+    threads = std::max(1u, std::min<unsigned>(threads, n / 65536 + 1));
+
+    std::vector<KeyIndex> pairs(n);
+    std::vector<KeyIndex> buffer(n);
+    auto sliceBegin = [&](unsigned t) { return n * t / threads; };
+
+    // Bits that differ from the first key; digits where none differ are
+    // skipped, e.g. the high bits shared by all timestamps of a run
+    std::vector<uint64_t> varying(threads, 0);
+    ForEachThread(threads, [&](unsigned t) {
+        uint64_t bits = 0;
+        for (size_t i = sliceBegin(t); i < sliceBegin(t + 1); i++) {
+            pairs[i] = {TimeStamp[i], i};
+            bits |= TimeStamp[i] ^ TimeStamp[0];
+        }
+        varying[t] = bits;
+    });
+    uint64_t differing = 0;
+    for (uint64_t bits : varying) {
+        differing |= bits;
+    }
+
+    // One stable counting pass per digit.  Each thread counts its slice,
+    // then scatters it behind the same digit of all earlier slices, so the
+    // passes stay stable and ties keep index order.
+    std::vector<size_t> offsets(threads * kRadixBuckets);
+    for (int shift = 0; shift < 64; shift += kRadixBits) {
+        if (((differing >> shift) & (kRadixBuckets - 1)) == 0) {
+            continue;
+        }
+
+        ForEachThread(threads, [&](unsigned t) {
+            size_t* count = &offsets[t * kRadixBuckets];
+            std::fill(count, count + kRadixBuckets, 0);
+            for (size_t i = sliceBegin(t); i < sliceBegin(t + 1); i++) {
+                count[(pairs[i].key >> shift) & (kRadixBuckets - 1)]++;
+            }
+        });
+
+        size_t position = 0;
+        for (size_t digit = 0; digit < kRadixBuckets; digit++) {
+            for (unsigned t = 0; t < threads; t++) {
+                size_t count = offsets[t * kRadixBuckets + digit];
+                offsets[t * kRadixBuckets + digit] = position;
+                position += count;
+            }
+        }
+
+        ForEachThread(threads, [&](unsigned t) {
+            size_t* next = &offsets[t * kRadixBuckets];
+            for (size_t i = sliceBegin(t); i < sliceBegin(t + 1); i++) {
+                buffer[next[(pairs[i].key >> shift) & (kRadixBuckets - 1)]++] = pairs[i];
+            }
+        });
+        pairs.swap(buffer);
+    }
+    buffer.clear();
+    buffer.shrink_to_fit();
+
+    std::vector<size_t> order(n);
+    ForEachThread(threads, [&](unsigned t) {
+        for (size_t i = sliceBegin(t); i < sliceBegin(t + 1); i++) {
+            order[i] = pairs[i].index;
+        }
+    });
+    return order;
+}
+
+size_t EventBatch::MemoryBytes() const {
+    return ColumnBytes(Mod) + ColumnBytes(Ch) + ColumnBytes(TimeStamp)
+         + ColumnBytes(FineTS) + ColumnBytes(ChargeLong) + ColumnBytes(ChargeShort)
+         + ColumnBytes(Extras)
+         + ColumnBytes(RecordLength) + ColumnBytes(TraceOffset)
+         + ColumnBytes(Trace2Length) + ColumnBytes(Samples);
+}
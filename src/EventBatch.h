@@ -0,0 +1,92 @@
+#ifndef EVENTBATCH_H
+#define EVENTBATCH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "../TreeData.h"
+
+// Non-owning view of one event in an EventBatch.  The trace pointers point
+// into the batch's sample pool and stay valid until the batch grows.
+struct EventView {
+    uint8_t Mod;
+    uint8_t Ch;
+    uint64_t TimeStamp;
+    double FineTS;
+    uint16_t ChargeLong;
+    uint16_t ChargeShort;
+    uint32_t Extras;
+    uint32_t RecordLength;
+    const uint16_t* Trace1;  // RecordLength samples, nullptr if none
+    const uint16_t* Trace2;  // Trace2Length samples, nullptr if none
+    uint32_t Trace2Length;
+};
+
+// Columnar event store.  One contiguous array per TreeData field, so a
+// PlainEvent costs only its payload bytes and sorting works on an index
+// permutation instead of chasing per-event heap objects.
+//
+// Waveforms live in one flat sample pool: Trace1 of event i starts at
+// Samples[TraceOffset[i]] and is RecordLength[i] samples long, Trace2 follows
+// directly with Trace2Length[i] samples.  The two trace columns stay empty
+// until the first event carrying a waveform is added.
+class EventBatch {
+public:
+    // Extras bits
+    static const uint32_t kGoodTrigger = 1;
+    static const uint32_t kLostTrigger = 2;
+
+    size_t Size() const { return TimeStamp.size(); }
+    bool Empty() const { return TimeStamp.empty(); }
+    bool HasTraces() const { return hasTraces_; }
+
+    void Clear();
+    void Reserve(size_t events, size_t samples = 0);
+
+    // Appends an event without waveforms and returns its index
+    size_t Add(uint8_t mod, uint8_t ch, uint64_t timeStamp, double fineTS,
+               uint16_t chargeLong, uint16_t chargeShort, uint32_t extras = 0);
+    // Allocates waveform storage for the last added event and returns the
+    // Trace1 pointer (Trace2 follows).  Valid until the next Add*/Append.
+    uint16_t* AddTraces(uint32_t length1, uint32_t length2 = 0);
+
+    void Add(const TreeData& data);
+    void Append(const EventBatch& other, size_t i);
+    void Append(const EventBatch& other);
+
+    // Copies event i into data, reusing data's vector capacity
+    void Get(size_t i, TreeData& data) const;
+    EventView View(size_t i) const;
+
+    const uint16_t* Trace1(size_t i) const;
+    const uint16_t* Trace2(size_t i) const;
+    uint32_t Trace2Size(size_t i) const { return hasTraces_ ? Trace2Length[i] : 0; }
+
+    // Event indices in timestamp order; ties keep insertion order
+    std::vector<size_t> StableTimeOrder() const;
+    // The same order from an LSD radix sort on (TimeStamp, index) pairs,
+    // with each pass split across `threads` threads
+    std::vector<size_t> RadixTimeOrder(unsigned threads = 1) const;
+
+    size_t MemoryBytes() const;
+
+    std::vector<uint8_t> Mod;
+    std::vector<uint8_t> Ch;
+    std::vector<uint64_t> TimeStamp;
+    std::vector<double> FineTS;
+    std::vector<uint16_t> ChargeLong;
+    std::vector<uint16_t> ChargeShort;
+    std::vector<uint32_t> Extras;  // Trigger flags of CrossData, see kGoodTrigger
+    std::vector<uint32_t> RecordLength;
+
+    std::vector<uint64_t> TraceOffset;
+    std::vector<uint32_t> Trace2Length;
+    std::vector<uint16_t> Samples;
+
+private:
+    void EnableTraces();
+
+    bool hasTraces_ = false;
+};
+
+#endif
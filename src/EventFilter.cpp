@@ -0,0 +1,101 @@
+#include "EventFilter.h"
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+bool ParseNumber(const std::string& text, uint64_t& value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    errno = 0;
+    value = std::strtoull(text.c_str(), nullptr, 10);
+    return errno == 0;
+}
+
+// "0,2,8-11" back from a set, for messages
+std::string FormatList(const std::bitset<256>& set) {
+    std::string text;
+    for (size_t i = 0; i < set.size(); i++) {
+        if (!set[i]) {
+            continue;
+        }
+        size_t last = i;
+        while (last + 1 < set.size() && set[last + 1]) {
+            last++;
+        }
+        text += (text.empty() ? "" : ",") + std::to_string(i);
+        if (last > i) {
+            text += "-" + std::to_string(last);
+        }
+        i = last;
+    }
+    return text;
+}
+
+}  // namespace
+
+bool EventFilter::ParseTimeRange(const std::string& text) {
+    const size_t colon = text.find(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    const std::string first = text.substr(0, colon);
+    const std::string last = text.substr(colon + 1);
+    uint64_t minTs = 0;
+    uint64_t maxTs = std::numeric_limits<uint64_t>::max();
+    if ((!first.empty() && !ParseNumber(first, minTs))
+        || (!last.empty() && !ParseNumber(last, maxTs)) || minTs >= maxTs) {
+        return false;
+    }
+    minTimeStamp_ = minTs;
+    maxTimeStamp_ = maxTs;
+    return true;
+}
+
+bool EventFilter::ParseList(const std::string& text, std::bitset<256>& set) {
+    std::bitset<256> parsed;
+    std::stringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        const size_t dash = item.find('-');
+        uint64_t first, last;
+        if (dash == std::string::npos) {
+            if (!ParseNumber(item, first)) {
+                return false;
+            }
+            last = first;
+        } else if (!ParseNumber(item.substr(0, dash), first)
+                   || !ParseNumber(item.substr(dash + 1), last)) {
+            return false;
+        }
+        if (first > last || last >= parsed.size()) {
+            return false;
+        }
+        for (uint64_t i = first; i <= last; i++) {
+            parsed.set(i);
+        }
+    }
+    if (parsed.none()) {
+        return false;
+    }
+    set = parsed;
+    return true;
+}
+
+std::string EventFilter::Describe() const {
+    std::string text;
+    if (HasTimeRange()) {
+        text = "time [" + std::to_string(minTimeStamp_) + ", "
+             + (maxTimeStamp_ == std::numeric_limits<uint64_t>::max()
+                    ? std::string("end") : std::to_string(maxTimeStamp_)) + ")";
+    }
+    if (!boards_.all()) {
+        text += (text.empty() ? "" : ", ") + std::string("boards ") + FormatList(boards_);
+    }
+    if (!channels_.all()) {
+        text += (text.empty() ? "" : ", ") + std::string("channels ") + FormatList(channels_);
+    }
+    return text.empty() ? "all events" : text;
+}
@@ -0,0 +1,52 @@
+#ifndef EVENTFILTER_H
+#define EVENTFILTER_H
+
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// Selects the events to convert by timestamp range, board and channel.  It
+// is applied in the decode loop, so rejected events never reach a batch;
+// with a packet index, packets outside the time range are not even read.
+// A default-constructed filter accepts everything.
+class EventFilter {
+public:
+    EventFilter() { boards_.set(); channels_.set(); }
+
+    // "START:END" in timestamp ticks, END exclusive; either side may be
+    // left empty ("START:" or ":END").  False on a malformed range.
+    bool ParseTimeRange(const std::string& text);
+    // Comma-separated numbers and inclusive ranges such as "0,2,8-11"
+    bool ParseBoards(const std::string& text) { return ParseList(text, boards_); }
+    bool ParseChannels(const std::string& text) { return ParseList(text, channels_); }
+
+    bool IsActive() const { return HasTimeRange() || !boards_.all() || !channels_.all(); }
+    bool HasTimeRange() const {
+        return minTimeStamp_ > 0 || maxTimeStamp_ < std::numeric_limits<uint64_t>::max();
+    }
+    uint64_t MinTimeStamp() const { return minTimeStamp_; }
+    uint64_t MaxTimeStamp() const { return maxTimeStamp_; }
+
+    bool Accepts(uint8_t mod, uint8_t ch, uint64_t timeStamp) const {
+        return timeStamp >= minTimeStamp_ && timeStamp < maxTimeStamp_
+            && boards_[mod] && channels_[ch];
+    }
+    // False if no timestamp in [first, last] can pass
+    bool OverlapsTime(uint64_t first, uint64_t last) const {
+        return last >= minTimeStamp_ && first < maxTimeStamp_;
+    }
+
+    // One-line summary such as "time [100, 200), boards 0,2"
+    std::string Describe() const;
+
+private:
+    static bool ParseList(const std::string& text, std::bitset<256>& set);
+
+    uint64_t minTimeStamp_ = 0;
+    uint64_t maxTimeStamp_ = std::numeric_limits<uint64_t>::max();
+    std::bitset<256> boards_;
+    std::bitset<256> channels_;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "EventGenerator.h"
+#include "PacketTraits.h"
+#include <capnp/serialize.h>
+#include <capnp/serialize-packed.h>
+#include <kj/io.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+const char* const kTypeNames[] = {
+    "plain", "psd", "wave", "dualwave", "full", "rawtime", "cross", "psdwave"
+};
+
+const uint16_t kBaseline = 1000;
+
+}  // namespace
+
+EventGenerator::EventGenerator(const GeneratorConfig& config)
+    : config_(config), rng_(config.seed) {
+    if (config_.packetSize == 0) {
+        config_.packetSize = 1;
+    }
+    if (config_.boards == 0) {
+        config_.boards = 1;
+    }
+    if (config_.channels == 0) {
+        config_.channels = 1;
+    }
+
+    // Unit-height pulse: fast rise at a quarter of the trace, slow decay
+    pulse_.resize(config_.samples);
+    const double t0 = config_.samples / 4.0;
+    for (uint32_t s = 0; s < config_.samples; s++) {
+        double t = s - t0;
+        pulse_[s] = t < 0 ? 0.0f : static_cast<float>((1 - std::exp(-t / 4)) * std::exp(-t / 60));
+    }
+}
+
+size_t EventGenerator::NumPackets() const {
+    return (config_.events + config_.packetSize - 1) / config_.packetSize;
+}
+
+const char* EventGenerator::TypeName(int type) {
+    return type >= 0 && type < 8 ? kTypeNames[type] : nullptr;
+}
+
+int EventGenerator::ParseType(const std::string& text) {
+    for (int type = 0; type < 8; type++) {
+        if (text == kTypeNames[type] || text == std::to_string(type)) {
+            return type;
+        }
+    }
+    return -1;
+}
+
+bool EventGenerator::Write(const std::string& filename) {
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot create output file " << filename << "\n";
+        return false;
+    }
+
+    bool ok = true;
+    try {
+        kj::FdOutputStream fdStream(fd);
+        kj::BufferedOutputStreamWrapper bufferedStream(fdStream);
+
+        size_t remaining = config_.events;
+        while (remaining > 0) {
+            size_t count = std::min(remaining, config_.packetSize);
+            capnp::MallocMessageBuilder message;
+            BuildPacket(message, count);
+            if (config_.packed) {
+                capnp::writePackedMessage(bufferedStream, message);
+            } else {
+                capnp::writeMessage(bufferedStream, message);
+            }
+            remaining -= count;
+        }
+        bufferedStream.flush();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Writing " << filename << " failed: " << e.what() << "\n";
+        ok = false;
+    }
+
+    close(fd);
+    return ok;
+}
+
+void EventGenerator::BuildPacket(capnp::MessageBuilder& message, size_t count) {
+    bool known = ForPacketType(config_.type, [&](auto tag) {
+        FillPacket<typename decltype(tag)::type>(message, count);
+    });
+    if (!known) {
+        throw std::runtime_error("unknown event type " + std::to_string(config_.type));
+    }
+}
+
+template <typename Data>
+void EventGenerator::FillPacket(capnp::MessageBuilder& message, size_t count) {
+    using Traits = PacketTraits<Data>;
+
+    auto data = message.initRoot<Data>();
+    data.setType(config_.type);
+    auto events = data.initEvents(count);
+
+    for (auto event : events) {
+        uint64_t random = rng_();
+        uint16_t energy = 100 + random % 16000;
+        event.setBoard((random >> 16) % config_.boards);
+        event.setChannel((random >> 24) % config_.channels);
+        event.setEnergy(energy);
+        event.setTimestamp(NextTimeStamp());
+
+        if constexpr (Traits::psd) {
+            event.setPsd(((random >> 32) & 0xFFFF) / 65536.0f);
+        }
+        if constexpr (Traits::fineTime) {
+            event.setFineTimestamp((random >> 32) & 0x3FF);
+        }
+        if constexpr (Traits::triggers) {
+            event.setGoodTrigger((random >> 32) & 1);
+            event.setLostTrigger(((random >> 33) & 0xFF) == 0);
+        }
+        if constexpr (Traits::waveforms >= 1) {
+            FillWaveform(event.initWaveform1(config_.samples), energy);
+        }
+        if constexpr (Traits::waveforms >= 2) {
+            FillWaveform(event.initWaveform2(config_.samples), energy / 2);
+        }
+    }
+}
+
+void EventGenerator::FillWaveform(capnp::List<int16_t>::Builder wave, uint16_t energy) {
+    // Digitizer-like trace: baseline, scaled pulse and a few ADC counts of noise
+    const float amplitude = energy;
+    uint64_t noise = rng_();
+    for (uint32_t s = 0; s < config_.samples; s++) {
+        if ((s & 15) == 0) {
+            noise = rng_();
+        }
+        int value = kBaseline + static_cast<int>(amplitude * pulse_[s]) + static_cast<int>(noise & 7) - 4;
+        noise >>= 4;
+        wave.set(s, static_cast<int16_t>(std::min(value, 32767)));
+    }
+}
+
+uint64_t EventGenerator::NextTimeStamp() {
+    clock_ += config_.spacing / 2 + rng_() % (config_.spacing + 1);
+    uint64_t ts = clock_;
+
+    // A fraction of events arrives late, up to disorderWindow ticks back
+    if (config_.disorder > 0 && std::generate_canonical<double, 32>(rng_) < config_.disorder) {
+        ts -= std::min<uint64_t>(ts, rng_() % (config_.disorderWindow + 1));
+    }
+    return ts;
+}
@@ -0,0 +1,58 @@
+#ifndef EVENTGENERATOR_H
+#define EVENTGENERATOR_H
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+#include <capnp/message.h>
+#include "eventProto.capnp.h"
+
+// Settings for a synthetic .cap file
+struct GeneratorConfig {
+    int type = 0;                  // Packet type field, 0-7 (see TypeName)
+    size_t events = 1000000;
+    size_t packetSize = 1000;      // Events per message
+    uint32_t samples = 512;        // Trace length for waveform types
+    unsigned boards = 4;
+    unsigned channels = 16;
+    uint64_t spacing = 100;        // Mean timestamp step between events
+    double disorder = 0.0;         // Fraction of events moved back in time
+    uint64_t disorderWindow = 10000;  // Largest backward move, in ticks
+    bool packed = true;            // false writes the unpacked framing
+    uint64_t seed = 1;
+};
+
+// Writes reproducible .cap files of any event type for tests and
+// benchmarks.  Events carry a random board/channel, energy and a pulse-shaped
+// waveform scaled by the energy; timestamps increase with optional local
+// disorder, as produced by the digitizer readout.
+class EventGenerator {
+public:
+    explicit EventGenerator(const GeneratorConfig& config);
+
+    // Writes config.events events; false if the file cannot be written
+    bool Write(const std::string& filename);
+
+    size_t NumPackets() const;
+
+    // "plain", "psd", ... for types 0-7, nullptr otherwise
+    static const char* TypeName(int type);
+    // Accepts a type number or name; returns -1 if unknown
+    static int ParseType(const std::string& text);
+
+private:
+    void BuildPacket(capnp::MessageBuilder& message, size_t count);
+    template <typename Data>
+    void FillPacket(capnp::MessageBuilder& message, size_t count);
+    void FillWaveform(capnp::List<int16_t>::Builder wave, uint16_t energy);
+    uint64_t NextTimeStamp();
+
+    GeneratorConfig config_;
+    std::mt19937_64 rng_;
+    uint64_t clock_ = 0;
+    std::vector<float> pulse_;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#include "EventWriter.h"
+#include "RootWriter.h"
+#ifdef CAP2ROOT_HAVE_RNTUPLE
+#include "NTupleWriter.h"
+#endif
+
+std::unique_ptr<EventWriter> EventWriter::Create(const std::string& format,
+                                                 const std::string& filename,
+                                                 int compression) {
+    if (format == "ttree") {
+        return std::make_unique<RootWriter>(filename, compression);
+    }
+#ifdef CAP2ROOT_HAVE_RNTUPLE
+    if (format == "rntuple") {
+        return std::make_unique<NTupleWriter>(filename, compression);
+    }
+#endif
+    return nullptr;
+}
+
+bool EventWriter::HasFormat(const std::string& format) {
+#ifdef CAP2ROOT_HAVE_RNTUPLE
+    if (format == "rntuple") {
+        return true;
+    }
+#endif
+    return format == "ttree";
+}
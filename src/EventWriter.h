@@ -0,0 +1,34 @@
+#ifndef EVENTWRITER_H
+#define EVENTWRITER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "EventBatch.h"
+
+// Output backend for converted events.  Every format writes the same fields
+// (Mod, Ch, TimeStamp, FineTS, ChargeLong, ChargeShort, Extras, RecordLength
+// and the Signal trace) under the name "ELIADE_Tree".
+class EventWriter {
+public:
+    virtual ~EventWriter() = default;
+
+    virtual void Fill(const EventView& event) = 0;
+    // Writes batch events [begin, end), through order when one is given
+    virtual void FillBatch(const EventBatch& batch, size_t begin, size_t end,
+                           const std::vector<size_t>* order = nullptr) = 0;
+    void FillBatch(const EventBatch& batch) { FillBatch(batch, 0, batch.Size()); }
+    // Writes what was filled so far, so that other processes can read it
+    // while filling continues
+    virtual void Flush() = 0;
+    virtual void Close() = 0;
+
+    // Formats: "ttree" and, when built against ROOT >= 6.34, "rntuple".
+    // Returns nullptr for a format that is unknown or not built in.
+    static std::unique_ptr<EventWriter> Create(const std::string& format,
+                                               const std::string& filename,
+                                               int compression);
+    static bool HasFormat(const std::string& format);
+};
+
+#endif
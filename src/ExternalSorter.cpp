@@ -0,0 +1,307 @@
+#include "ExternalSorter.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <unistd.h>
+
+namespace {
+
+// In-memory size of one event's columns, excluding its samples
+const size_t kEventBytes = sizeof(uint8_t) * 2 + sizeof(uint64_t) + sizeof(double)
+                         + sizeof(uint16_t) * 2 + sizeof(uint32_t) * 2
+                         + sizeof(uint64_t) + sizeof(uint32_t);
+
+template <typename T>
+void WriteValue(FILE* fp, const T& value) {
+    if (fwrite(&value, sizeof(T), 1, fp) != 1) {
+        throw std::runtime_error("ExternalSorter: failed to write chunk file");
+    }
+}
+
+template <typename T>
+void ReadValue(FILE* fp, T& value) {
+    if (fread(&value, sizeof(T), 1, fp) != 1) {
+        throw std::runtime_error("ExternalSorter: truncated chunk file");
+    }
+}
+
+// Chunk records are row-wise: the scalar fields, the two trace lengths and
+// then the samples of Trace1 followed by Trace2.
+void WriteEvent(FILE* fp, const EventBatch& batch, size_t i) {
+    WriteValue(fp, batch.Mod[i]);
+    WriteValue(fp, batch.Ch[i]);
+    WriteValue(fp, batch.TimeStamp[i]);
+    WriteValue(fp, batch.FineTS[i]);
+    WriteValue(fp, batch.ChargeLong[i]);
+    WriteValue(fp, batch.ChargeShort[i]);
+    WriteValue(fp, batch.Extras[i]);
+    WriteValue(fp, batch.RecordLength[i]);
+    WriteValue(fp, batch.Trace2Size(i));
+
+    size_t samples = batch.RecordLength[i] + batch.Trace2Size(i);
+    if (samples > 0 && fwrite(batch.Trace1(i), sizeof(uint16_t), samples, fp) != samples) {
+        throw std::runtime_error("ExternalSorter: failed to write chunk file");
+    }
+}
+
+// Returns the bytes the event occupies in the batch
+size_t ReadEvent(FILE* fp, EventBatch& batch) {
+    uint8_t mod, ch;
+    uint64_t timeStamp;
+    double fineTS;
+    uint16_t chargeLong, chargeShort;
+    uint32_t extras, length1, length2;
+
+    ReadValue(fp, mod);
+    ReadValue(fp, ch);
+    ReadValue(fp, timeStamp);
+    ReadValue(fp, fineTS);
+    ReadValue(fp, chargeLong);
+    ReadValue(fp, chargeShort);
+    ReadValue(fp, extras);
+    ReadValue(fp, length1);
+    ReadValue(fp, length2);
+
+    batch.Add(mod, ch, timeStamp, fineTS, chargeLong, chargeShort, extras);
+    size_t samples = static_cast<size_t>(length1) + length2;
+    if (samples > 0) {
+        uint16_t* dst = batch.AddTraces(length1, length2);
+        if (fread(dst, sizeof(uint16_t), samples, fp) != samples) {
+            throw std::runtime_error("ExternalSorter: truncated chunk file");
+        }
+    }
+    return kEventBytes + samples * sizeof(uint16_t);
+}
+
+// Sequential reader over one spilled chunk, holding one block of events.
+// A block holds at least one event and stops once it reaches blockBytes.
+struct ChunkCursor {
+    FILE* fp = nullptr;
+    uint64_t remaining = 0;
+    size_t blockBytes = 0;
+    EventBatch block;
+    size_t pos = 0;
+
+    ChunkCursor() = default;
+    ChunkCursor(const ChunkCursor&) = delete;
+    ChunkCursor& operator=(const ChunkCursor&) = delete;
+
+    // The FILE* is owned; a moved-from cursor no longer closes it
+    ChunkCursor(ChunkCursor&& other) noexcept
+        : fp(other.fp)
+        , remaining(other.remaining)
+        , blockBytes(other.blockBytes)
+        , block(std::move(other.block))
+        , pos(other.pos)
+    {
+        other.fp = nullptr;
+    }
+
+    ChunkCursor& operator=(ChunkCursor&& other) noexcept {
+        if (this != &other) {
+            if (fp) {
+                fclose(fp);
+            }
+            fp = other.fp;
+            remaining = other.remaining;
+            blockBytes = other.blockBytes;
+            block = std::move(other.block);
+            pos = other.pos;
+            other.fp = nullptr;
+        }
+        return *this;
+    }
+
+    ~ChunkCursor() {
+        if (fp) {
+            fclose(fp);
+        }
+    }
+
+    uint64_t TimeStamp() const { return block.TimeStamp[pos]; }
+
+    bool Next() {
+        if (++pos < block.Size()) {
+            return true;
+        }
+        if (remaining == 0) {
+            return false;
+        }
+
+        block.Clear();
+        pos = 0;
+        size_t bytes = 0;
+        while (remaining > 0 && (block.Empty() || bytes < blockBytes)) {
+            bytes += ReadEvent(fp, block);
+            remaining--;
+        }
+        return true;
+    }
+};
+
+}  // namespace
+
+// Cursors over every run plus the heap of their current timestamps.  Heap
+// entries are (timestamp, run); the in-memory tail is the last run, so ties
+// go to earlier chunks.
+struct ExternalSorter::MergeState {
+    using Entry = std::pair<uint64_t, size_t>;
+
+    std::vector<ChunkCursor> cursors;
+    std::vector<size_t> memoryOrder;
+    size_t memoryPos = 0;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    // Run whose current event was handed out last; advanced on the next call
+    // so the event stays valid in the meantime
+    size_t pending = SIZE_MAX;
+};
+
+ExternalSorter::ExternalSorter(size_t memoryBudget, const std::string& tmpDir)
+    : budget_(memoryBudget)
+    , tmpDir_(tmpDir.empty() ? std::filesystem::temp_directory_path().string() : tmpDir)
+{
+}
+
+ExternalSorter::~ExternalSorter() {
+    merge_.reset();
+    RemoveChunks();
+}
+
+void ExternalSorter::Add(const EventBatch& batch) {
+    buffer_.Append(batch);
+    numEvents_ += batch.Size();
+
+    if (buffer_.MemoryBytes() >= budget_) {
+        Spill();
+    }
+}
+
+void ExternalSorter::Flush() {
+    Spill();
+}
+
+void ExternalSorter::Spill() {
+    if (buffer_.Empty()) {
+        return;
+    }
+
+    std::vector<size_t> order = buffer_.StableTimeOrder();
+
+    std::string path = tmpDir_ + "/cap2root_chunk_XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        throw std::runtime_error("ExternalSorter: cannot create chunk file in " + tmpDir_);
+    }
+    chunkFiles_.push_back(path);
+
+    FILE* fp = fdopen(fd, "wb");
+    if (!fp) {
+        close(fd);
+        throw std::runtime_error("ExternalSorter: cannot open chunk file " + path);
+    }
+
+    WriteValue(fp, static_cast<uint64_t>(order.size()));
+    for (size_t i : order) {
+        WriteEvent(fp, buffer_, i);
+    }
+    if (fclose(fp) != 0) {
+        throw std::runtime_error("ExternalSorter: failed to close chunk file " + path);
+    }
+
+    // Release the memory rather than keeping the peak capacity around
+    buffer_ = EventBatch();
+}
+
+void ExternalSorter::Merge(const Sink& sink) {
+    BeginMerge();
+    const EventBatch* batch;
+    size_t index;
+    while (Next(batch, index)) {
+        sink(*batch, index);
+    }
+}
+
+void ExternalSorter::BeginMerge(size_t mergeBudget) {
+    merge_ = std::make_unique<MergeState>();
+    MergeState& state = *merge_;
+
+    // The tail that never reached the budget stays in memory as the last run.
+    state.memoryOrder = buffer_.StableTimeOrder();
+
+    // The read-back blocks of all chunks share the budget
+    blockBytes_ = (mergeBudget > 0 ? mergeBudget : budget_) / std::max<size_t>(1, chunkFiles_.size());
+
+    state.cursors.resize(chunkFiles_.size());
+    for (size_t i = 0; i < chunkFiles_.size(); i++) {
+        state.cursors[i].blockBytes = blockBytes_;
+        state.cursors[i].fp = fopen(chunkFiles_[i].c_str(), "rb");
+        if (!state.cursors[i].fp) {
+            throw std::runtime_error("ExternalSorter: cannot reopen chunk file " + chunkFiles_[i]);
+        }
+        ReadValue(state.cursors[i].fp, state.cursors[i].remaining);
+    }
+
+    for (size_t i = 0; i < state.cursors.size(); i++) {
+        if (state.cursors[i].Next()) {
+            state.heap.emplace(state.cursors[i].TimeStamp(), i);
+        }
+    }
+    if (!state.memoryOrder.empty()) {
+        state.heap.emplace(buffer_.TimeStamp[state.memoryOrder[0]], state.cursors.size());
+    }
+}
+
+bool ExternalSorter::Next(const EventBatch*& batch, size_t& index) {
+    if (!merge_) {
+        return false;
+    }
+    MergeState& state = *merge_;
+    const size_t memoryRun = state.cursors.size();
+
+    if (state.pending == memoryRun) {
+        if (++state.memoryPos < state.memoryOrder.size()) {
+            state.heap.emplace(buffer_.TimeStamp[state.memoryOrder[state.memoryPos]], memoryRun);
+        }
+    } else if (state.pending != SIZE_MAX) {
+        ChunkCursor& cursor = state.cursors[state.pending];
+        if (cursor.Next()) {
+            state.heap.emplace(cursor.TimeStamp(), state.pending);
+        }
+    }
+
+    if (state.heap.empty()) {
+        EndMerge();
+        return false;
+    }
+
+    size_t run = state.heap.top().second;
+    state.heap.pop();
+    state.pending = run;
+
+    if (run == memoryRun) {
+        batch = &buffer_;
+        index = state.memoryOrder[state.memoryPos];
+    } else {
+        batch = &state.cursors[run].block;
+        index = state.cursors[run].pos;
+    }
+    return true;
+}
+
+void ExternalSorter::EndMerge() {
+    merge_.reset();
+    buffer_ = EventBatch();
+    RemoveChunks();
+}
+
+void ExternalSorter::RemoveChunks() {
+    for (const auto& path : chunkFiles_) {
+        std::remove(path.c_str());
+    }
+    chunkFiles_.clear();
+}
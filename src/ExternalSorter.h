@@ -0,0 +1,62 @@
+#ifndef EXTERNALSORTER_H
+#define EXTERNALSORTER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include "EventBatch.h"
+
+// Bounded-memory timestamp sort.  Events are buffered until the budget is
+// reached, then the buffer is sorted and spilled to a temporary chunk file.
+// Merge() k-way merges all chunks (plus whatever is still buffered) and hands
+// the events to the sink in timestamp order.  Sorting is stable and ties
+// between chunks go to the earlier chunk, so the output order is identical
+// to EventBatch::StableTimeOrder() over the whole input.
+//
+// BeginMerge()/Next() is the same merge in pull form, for callers that
+// interleave several sorters.
+class ExternalSorter {
+public:
+    // Sink receives the batch holding the event and the event's index in it
+    using Sink = std::function<void(const EventBatch&, size_t)>;
+
+    explicit ExternalSorter(size_t memoryBudget, const std::string& tmpDir = "");
+    ~ExternalSorter();
+
+    void Add(const EventBatch& batch);
+    // Spills whatever is buffered, leaving no events in memory
+    void Flush();
+    void Merge(const Sink& sink);
+
+    // mergeBudget bounds the read-back blocks of all chunks together;
+    // 0 uses the sorter's own budget
+    void BeginMerge(size_t mergeBudget = 0);
+    // Points batch/index at the next event in timestamp order, valid until
+    // the following call; false once all events were delivered
+    bool Next(const EventBatch*& batch, size_t& index);
+
+    size_t NumEvents() const { return numEvents_; }
+    size_t NumChunks() const { return chunkFiles_.size(); }
+    size_t BufferedBytes() const { return buffer_.MemoryBytes(); }
+    // Bytes each chunk reads back at a time during the merge, the merge
+    // budget split over the chunks; a block always holds at least one event
+    size_t BlockBytes() const { return blockBytes_; }
+
+private:
+    struct MergeState;
+
+    void Spill();
+    void EndMerge();
+    void RemoveChunks();
+
+    size_t budget_;
+    std::string tmpDir_;
+    EventBatch buffer_;
+    size_t numEvents_ = 0;
+    size_t blockBytes_ = 0;
+    std::vector<std::string> chunkFiles_;
+    std::unique_ptr<MergeState> merge_;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "FileFollower.h"
+#include "CapnpReader.h"
+#include "MessageIndex.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+namespace {
+
+// Bytes read per Poll(), so a large backlog is decoded in steps
+const size_t kMaxPollBytes = 64 * 1024 * 1024;
+const int kPollFallbackMs = 200;
+
+}  // namespace
+
+bool FileFollower::Open(const std::string& filename) {
+    Close();
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ >= 0 && inotify_add_watch(inotifyFd_, filename.c_str(), IN_MODIFY) < 0) {
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+    return true;
+}
+
+void FileFollower::Close() {
+    if (inotifyFd_ >= 0) {
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    offset_ = 0;
+    pending_.clear();
+    pendingPos_ = 0;
+    framing_ = -1;
+    packets_ = 0;
+}
+
+bool FileFollower::DetectFraming() {
+    // An unpacked file starts with the segment count minus one as a
+    // little-endian uint32, so its upper bytes are zero.  In a packed file
+    // the first byte is a tag and the next ones are the non-zero bytes it
+    // marks, so the two framings differ from the first word on.
+    if (pending_.size() - pendingPos_ < 8) {
+        return false;
+    }
+    const uint8_t* data = pending_.data() + pendingPos_;
+    framing_ = data[1] == 0 && data[2] == 0 && data[3] == 0 ? 0 : 1;
+    return true;
+}
+
+size_t FileFollower::Poll(EventBatch& batch) {
+    if (fd_ < 0 || malformed_) {
+        return 0;
+    }
+
+    // Drop consumed bytes, keep the incomplete tail, append new data
+    pending_.erase(pending_.begin(), pending_.begin() + pendingPos_);
+    pendingPos_ = 0;
+
+    struct stat st;
+    size_t available = 0;
+    if (fstat(fd_, &st) == 0 && static_cast<uint64_t>(st.st_size) > offset_) {
+        available = std::min<uint64_t>(st.st_size - offset_, kMaxPollBytes);
+    }
+
+    size_t tail = pending_.size();
+    pending_.resize(tail + available);
+    size_t filled = 0;
+    while (filled < available) {
+        ssize_t n = pread(fd_, pending_.data() + tail + filled, available - filled,
+                          offset_ + filled);
+        if (n <= 0) {
+            break;
+        }
+        filled += n;
+    }
+    pending_.resize(tail + filled);
+    offset_ += filled;
+
+    if (framing_ < 0 && !DetectFraming()) {
+        return 0;
+    }
+
+    const EventFilter* filter = filter_.IsActive() ? &filter_ : nullptr;
+    size_t added = 0;
+    for (;;) {
+        const uint8_t* data = pending_.data() + pendingPos_;
+        size_t size = pending_.size() - pendingPos_;
+        size_t length = framing_ ? MessageIndex::PackedMessageLength(data, size, &malformed_)
+                                 : MessageIndex::UnpackedMessageLength(data, size, &malformed_);
+        if (length == 0) {
+            break;
+        }
+        added += CapnpReader::DecodeBytes(data, length, framing_ == 1, batch, filter);
+        pendingPos_ += length;
+        packets_++;
+    }
+    return added;
+}
+
+bool FileFollower::Wait(int timeoutMs) {
+    if (fd_ < 0) {
+        return false;
+    }
+
+    if (inotifyFd_ < 0) {
+        // No inotify (e.g. some network file systems): compare the size
+        struct stat st;
+        for (int waited = 0; waited < timeoutMs; waited += kPollFallbackMs) {
+            if (fstat(fd_, &st) == 0 && static_cast<uint64_t>(st.st_size) > offset_) {
+                return true;
+            }
+            usleep(kPollFallbackMs * 1000);
+        }
+        return fstat(fd_, &st) == 0 && static_cast<uint64_t>(st.st_size) > offset_;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) == 0 && static_cast<uint64_t>(st.st_size) > offset_) {
+        return true;
+    }
+    struct pollfd pfd = {inotifyFd_, POLLIN, 0};
+    if (poll(&pfd, 1, timeoutMs) <= 0) {
+        return false;
+    }
+    // Drain the queued events; only "something changed" matters
+    char events[4096];
+    while (read(inotifyFd_, events, sizeof(events)) > 0) {
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef FILEFOLLOWER_H
+#define FILEFOLLOWER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "EventBatch.h"
+#include "EventFilter.h"
+
+// Reads a .cap file while the DAQ is still appending to it.  Each Poll()
+// reads the bytes added since the last call and decodes the messages that
+// are complete; a message cut off at the current end of the file is kept
+// until the rest arrives.  Wait() blocks until the file changes, through
+// inotify where available and by polling otherwise.
+class FileFollower {
+public:
+    FileFollower() = default;
+    ~FileFollower() { Close(); }
+
+    bool Open(const std::string& filename);
+    void Close();
+    // Events the filter rejects are dropped while decoding
+    void SetFilter(const EventFilter& filter) { filter_ = filter; }
+
+    // Appends the newly completed messages to batch; returns events added.
+    // At most 64 MB are read per call, so a backlog takes several calls.
+    // Decoding errors propagate as exceptions.  A malformed message stops
+    // the follower: appended data could never complete it, so later calls
+    // return 0 and Malformed() is true.
+    size_t Poll(EventBatch& batch);
+    // Waits up to timeoutMs for the file to grow; false on timeout
+    bool Wait(int timeoutMs);
+
+    bool UsesInotify() const { return inotifyFd_ >= 0; }
+    uint64_t BytesRead() const { return offset_; }
+    size_t NumPackets() const { return packets_; }
+    size_t PendingBytes() const { return pending_.size() - pendingPos_; }
+    bool Malformed() const { return malformed_; }
+
+private:
+    bool DetectFraming();
+
+    int fd_ = -1;
+    int inotifyFd_ = -1;
+    uint64_t offset_ = 0;       // File bytes consumed into pending_
+    std::vector<uint8_t> pending_;
+    size_t pendingPos_ = 0;     // Start of the first incomplete message
+    int framing_ = -1;          // -1 unknown, 0 unpacked, 1 packed
+    size_t packets_ = 0;
+    bool malformed_ = false;
+    EventFilter filter_;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "FileSummary.h"
+#include "PacketTraits.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+const unsigned kStreams = 256 * 256;
+
+// One worker's counts; merged once all workers are done
+struct Partial {
+    std::vector<ChannelSummary> channels = std::vector<ChannelSummary>(kStreams);
+    std::vector<TypeCount> types = std::vector<TypeCount>(CapnpReader::kNumTypes + 1, TypeCount{0, 0});
+};
+
+void Merge(ChannelSummary& into, const ChannelSummary& from) {
+    into.events += from.events;
+    into.minTimeStamp = std::min(into.minTimeStamp, from.minTimeStamp);
+    into.maxTimeStamp = std::max(into.maxTimeStamp, from.maxTimeStamp);
+}
+
+// Events per second over the span, with tickNs nanoseconds per tick
+double Rate(uint64_t events, uint64_t ticks, double tickNs) {
+    return ticks > 0 ? events / (ticks * tickNs * 1e-9) : 0;
+}
+
+}  // namespace
+
+bool FileSummary::Build(const std::string& filename, unsigned threads) {
+    threads = std::max(1u, threads);
+    std::vector<Partial> partials(threads);
+
+    MessageIndex index;
+    complete_ = CapnpReader::ScanMessages(filename, index, threads,
+                                          [&](unsigned part, size_t, capnp::MessageReader& message) {
+        Partial& partial = partials[part];
+        const int type = message.getRoot<PlainData>().getType();
+        bool known = ForPacketType(type, [&](auto tag) {
+            using Data = typename decltype(tag)::type;
+            auto events = message.getRoot<Data>().getEvents();
+            for (auto event : events) {
+                ChannelSummary& channel = partial.channels[event.getBoard() * 256u + event.getChannel()];
+                const uint64_t ts = event.getTimestamp();
+                channel.events++;
+                channel.minTimeStamp = std::min(channel.minTimeStamp, ts);
+                channel.maxTimeStamp = std::max(channel.maxTimeStamp, ts);
+            }
+            partial.types[type].packets++;
+            partial.types[type].events += events.size();
+        });
+        if (!known) {
+            partial.types[CapnpReader::kNumTypes].packets++;
+        }
+    });
+    if (index.Size() == 0 && !complete_) {
+        return false;
+    }
+
+    struct stat st;
+    fileBytes_ = stat(filename.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    packed_ = index.IsPacked();
+
+    types_.assign(CapnpReader::kNumTypes + 1, TypeCount{0, 0});
+    channels_.clear();
+    total_ = ChannelSummary();
+    std::vector<ChannelSummary> channels(kStreams);
+    for (const Partial& partial : partials) {
+        for (size_t type = 0; type < types_.size(); type++) {
+            types_[type].packets += partial.types[type].packets;
+            types_[type].events += partial.types[type].events;
+        }
+        for (unsigned stream = 0; stream < kStreams; stream++) {
+            if (partial.channels[stream].events > 0) {
+                Merge(channels[stream], partial.channels[stream]);
+            }
+        }
+    }
+    for (unsigned stream = 0; stream < kStreams; stream++) {
+        if (channels[stream].events > 0) {
+            channels_.emplace_back(stream, channels[stream]);
+            Merge(total_, channels[stream]);
+        }
+    }
+    return true;
+}
+
+uint64_t FileSummary::NumPackets() const {
+    uint64_t packets = 0;
+    for (const TypeCount& count : types_) {
+        packets += count.packets;
+    }
+    return packets;
+}
+
+uint64_t FileSummary::NumEvents() const {
+    return total_.events;
+}
+
+void FileSummary::Print(std::ostream& out, double tickNs) const {
+    std::ios_base::fmtflags flags = out.flags();
+    const uint64_t span = total_.events > 0 ? total_.maxTimeStamp - total_.minTimeStamp : 0;
+
+    out << "File size:   " << fileBytes_ << " bytes, " << (packed_ ? "packed" : "unpacked")
+        << " framing\n";
+    out << "Packets:     " << NumPackets() << "\n";
+    out << "Events:      " << NumEvents() << "\n";
+    if (total_.events > 0) {
+        out << "Timestamps:  " << total_.minTimeStamp << " - " << total_.maxTimeStamp
+            << " (" << std::fixed << std::setprecision(3) << span * tickNs * 1e-9
+            << " s at " << std::setprecision(3) << tickNs << " ns/tick)\n";
+    }
+
+    out << "\nEvent types:\n";
+    for (int type = 0; type <= CapnpReader::kNumTypes; type++) {
+        if (types_[type].packets == 0) {
+            continue;
+        }
+        out << std::left << std::setw(14) << CapnpReader::TypeName(type) << std::right
+            << std::setw(10) << types_[type].packets << " packets"
+            << std::setw(14) << types_[type].events << " events\n";
+    }
+
+    // Rates are over the whole file's time span, so streams compare directly
+    out << "\n" << std::setw(4) << "Mod" << std::setw(5) << "Ch" << std::setw(13) << "Events"
+        << std::setw(21) << "First TS" << std::setw(21) << "Last TS"
+        << std::setw(13) << "Rate[Hz]" << "\n";
+    out << std::string(77, '-') << "\n";
+    out << std::fixed << std::setprecision(1);
+    for (const auto& entry : channels_) {
+        const ChannelSummary& channel = entry.second;
+        out << std::setw(4) << entry.first / 256 << std::setw(5) << entry.first % 256
+            << std::setw(13) << channel.events
+            << std::setw(21) << channel.minTimeStamp << std::setw(21) << channel.maxTimeStamp
+            << std::setw(13) << Rate(channel.events, span, tickNs) << "\n";
+    }
+    out << std::setw(9) << "All" << std::setw(13) << total_.events
+        << std::setw(55) << Rate(total_.events, span, tickNs) << "\n";
+
+    out.flags(flags);
+}
@@ -0,0 +1,50 @@
+#ifndef FILESUMMARY_H
+#define FILESUMMARY_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <ostream>
+#include <cstdint>
+#include "CapnpReader.h"
+
+// Events and time range of one (Mod, Ch) stream
+struct ChannelSummary {
+    uint64_t events = 0;
+    uint64_t minTimeStamp = UINT64_MAX;
+    uint64_t maxTimeStamp = 0;
+};
+
+// Statistics of a .cap file gathered without decoding events: each worker
+// reads only the packet type, list sizes, board, channel and timestamp of
+// every event straight from the message, so no batch or TreeData is built
+// and no waveform is copied.
+class FileSummary {
+public:
+    // False if the file cannot be read; a truncated or partly undecodable
+    // file is summarized up to the damage and Complete() is false
+    bool Build(const std::string& filename, unsigned threads);
+
+    // tickNs converts timestamp ticks to time for the rates
+    void Print(std::ostream& out, double tickNs) const;
+
+    bool Complete() const { return complete_; }
+    uint64_t FileBytes() const { return fileBytes_; }
+    bool IsPacked() const { return packed_; }
+    uint64_t NumPackets() const;
+    uint64_t NumEvents() const;
+    const std::vector<TypeCount>& Types() const { return types_; }
+    // Streams with at least one event, keyed Mod * 256 + Ch
+    const std::vector<std::pair<unsigned, ChannelSummary>>& Channels() const { return channels_; }
+    const ChannelSummary& Total() const { return total_; }
+
+private:
+    uint64_t fileBytes_ = 0;
+    bool packed_ = true;
+    bool complete_ = false;
+    std::vector<TypeCount> types_;
+    std::vector<std::pair<unsigned, ChannelSummary>> channels_;
+    ChannelSummary total_;
+};
+
+#endif
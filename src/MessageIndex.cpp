@@ -0,0 +1,300 @@
+#include "MessageIndex.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+const uint32_t kMaxSegments = 512;
+// Readers refuse to traverse more words than this, so a bigger segment table
+// can only be garbage
+const size_t kMaxMessageWords = 100000000;
+
+// Sidecar layout: a header stamped with the size and modification time of
+// the .cap file, then one MessageEntry per message, all in host byte order
+const char kSidecarMagic[8] = {'C', 'A', 'P', 'I', 'D', 'X', '0', '1'};
+
+struct SidecarHeader {
+    char magic[8];
+    uint32_t packed;
+    uint32_t reserved;
+    uint64_t capSize;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    uint64_t messages;
+};
+
+static_assert(sizeof(MessageEntry) == 40, "MessageEntry is stored as-is in .capidx files");
+
+bool StampOf(const std::string& capFile, SidecarHeader& header) {
+    struct stat st;
+    if (stat(capFile.c_str(), &st) != 0) {
+        return false;
+    }
+    header.capSize = static_cast<uint64_t>(st.st_size);
+    header.mtimeSec = st.st_mtim.tv_sec;
+    header.mtimeNsec = st.st_mtim.tv_nsec;
+    return true;
+}
+
+// Size in words of the message described by an unpacked segment table, or 0
+// while the table is incomplete.  Sets bad on a corrupt table.
+size_t MessageWords(const uint8_t* header, size_t size, bool& bad) {
+    if (size < 4) {
+        return 0;
+    }
+    uint32_t segmentCount;
+    std::memcpy(&segmentCount, header, 4);
+    segmentCount += 1;
+    if (segmentCount == 0 || segmentCount > kMaxSegments) {
+        bad = true;
+        return 0;
+    }
+
+    size_t headerWords = (4 + 4 * static_cast<size_t>(segmentCount) + 7) / 8;
+    if (size < headerWords * 8) {
+        return 0;
+    }
+
+    size_t bodyWords = 0;
+    for (uint32_t i = 0; i < segmentCount; i++) {
+        uint32_t words;
+        std::memcpy(&words, header + 4 + 4 * i, 4);
+        bodyWords += words;
+    }
+    if (bodyWords == 0 || bodyWords > kMaxMessageWords) {
+        bad = true;
+        return 0;
+    }
+    return headerWords + bodyWords;
+}
+
+}  // namespace
+
+size_t MessageIndex::UnpackedMessageLength(const void* data, size_t size, bool* malformed) {
+    bool bad = false;
+    size_t words = MessageWords(static_cast<const uint8_t*>(data), size, bad);
+    if (malformed) {
+        *malformed = bad;
+    }
+    if (bad || words == 0 || size / 8 < words) {
+        return 0;
+    }
+    return words * 8;
+}
+
+size_t MessageIndex::PackedMessageLength(const void* data, size_t size, bool* malformed) {
+    // Packed encoding: every word starts with a tag byte whose set bits mark
+    // the non-zero bytes that follow.  Tag 0x00 is followed by a count of
+    // extra zero words, tag 0xFF by a count of raw words copied verbatim.
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    size_t pos = 0;
+    size_t words = 0;
+    size_t target = 0;
+
+    // The segment table is unpacked to learn the message size; after that
+    // words are only counted
+    uint8_t header[4 + 4 * kMaxSegments + 8];
+    size_t headerSize = 0;
+    bool bad = false;
+    if (malformed) {
+        *malformed = false;
+    }
+
+    while (target == 0 || words < target) {
+        if (pos >= size) {
+            return 0;
+        }
+        uint8_t tag = in[pos++];
+
+        uint8_t word[8] = {0};
+        for (int b = 0; b < 8; b++) {
+            if (tag & (1u << b)) {
+                if (pos >= size) {
+                    return 0;
+                }
+                word[b] = in[pos++];
+            }
+        }
+        size_t runWords = 0;
+        const uint8_t* raw = nullptr;
+        if (tag == 0x00 || tag == 0xFF) {
+            if (pos >= size) {
+                return 0;
+            }
+            runWords = in[pos++];
+            if (tag == 0xFF) {
+                if (size - pos < runWords * 8) {
+                    return 0;
+                }
+                raw = in + pos;
+                pos += runWords * 8;
+            }
+        }
+        words += 1 + runWords;
+
+        if (target == 0) {
+            for (size_t w = 0; w <= runWords && headerSize + 8 <= sizeof(header); w++) {
+                if (w == 0) {
+                    std::memcpy(header + headerSize, word, 8);
+                } else if (raw) {
+                    std::memcpy(header + headerSize, raw + (w - 1) * 8, 8);
+                } else {
+                    std::memset(header + headerSize, 0, 8);
+                }
+                headerSize += 8;
+            }
+            target = MessageWords(header, headerSize, bad);
+            if (bad) {
+                if (malformed) {
+                    *malformed = true;
+                }
+                return 0;
+            }
+        }
+    }
+
+    // Packing never runs across a message boundary
+    if (words != target) {
+        if (malformed) {
+            *malformed = true;
+        }
+        return 0;
+    }
+    return pos;
+}
+
+bool MessageIndex::Build(const void* data, size_t size, bool packed) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t pos = 0;
+
+    entries_.clear();
+    packed_ = packed;
+    while (pos < size) {
+        size_t length = packed ? PackedMessageLength(bytes + pos, size - pos)
+                               : UnpackedMessageLength(bytes + pos, size - pos);
+        if (length == 0) {
+            return false;
+        }
+        entries_.push_back({pos, length});
+        pos += length;
+    }
+    return true;
+}
+
+void MessageIndex::Describe(size_t i, uint32_t type, uint32_t events,
+                            uint64_t minTimeStamp, uint64_t maxTimeStamp) {
+    MessageEntry& entry = entries_[i];
+    entry.type = type;
+    entry.events = events;
+    entry.minTimeStamp = minTimeStamp;
+    entry.maxTimeStamp = maxTimeStamp;
+}
+
+std::string MessageIndex::SidecarPath(const std::string& capFile) {
+    const std::string extension = ".cap";
+    if (capFile.size() > extension.size()
+        && capFile.compare(capFile.size() - extension.size(), extension.size(), extension) == 0) {
+        return capFile + "idx";
+    }
+    return capFile + ".capidx";
+}
+
+bool MessageIndex::Save(const std::string& capFile) const {
+    SidecarHeader header = {};
+    std::memcpy(header.magic, kSidecarMagic, sizeof(header.magic));
+    header.packed = packed_ ? 1 : 0;
+    header.messages = entries_.size();
+    if (!StampOf(capFile, header)) {
+        return false;
+    }
+
+    // Written under a temporary name so a reader never sees half a sidecar
+    const std::string path = SidecarPath(capFile);
+    const std::string partial = path + ".part";
+    FILE* fp = fopen(partial.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+           && fwrite(entries_.data(), sizeof(MessageEntry), entries_.size(), fp) == entries_.size();
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || std::rename(partial.c_str(), path.c_str()) != 0) {
+        std::remove(partial.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MessageIndex::Load(const std::string& capFile) {
+    SidecarHeader expected = {};
+    if (!StampOf(capFile, expected)) {
+        return false;
+    }
+    FILE* fp = fopen(SidecarPath(capFile).c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+
+    SidecarHeader header;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1
+           && std::memcmp(header.magic, kSidecarMagic, sizeof(header.magic)) == 0
+           && header.capSize == expected.capSize
+           && header.mtimeSec == expected.mtimeSec
+           && header.mtimeNsec == expected.mtimeNsec
+           && header.messages <= header.capSize;
+    std::vector<MessageEntry> entries;
+    if (ok) {
+        entries.resize(header.messages);
+        ok = fread(entries.data(), sizeof(MessageEntry), entries.size(), fp) == entries.size();
+    }
+    fclose(fp);
+
+    // The messages must tile the whole file, as Build() would have found
+    // them; a prefix would make readers silently drop the remaining messages
+    uint64_t pos = 0;
+    for (size_t i = 0; ok && i < entries.size(); i++) {
+        ok = entries[i].offset == pos && entries[i].length > 0;
+        pos += entries[i].length;
+    }
+    if (!ok || pos != header.capSize) {
+        return false;
+    }
+    entries_ = std::move(entries);
+    packed_ = header.packed != 0;
+    return true;
+}
+
+std::vector<size_t> MessageIndex::Partition(size_t parts) const {
+    std::vector<size_t> bounds = {0};
+    if (entries_.empty() || parts == 0) {
+        bounds.push_back(entries_.size());
+        return bounds;
+    }
+
+    const MessageEntry& last = entries_.back();
+    const uint64_t total = last.offset + last.length;
+    for (size_t part = 1; part < parts; part++) {
+        // First message starting at or after the part's share of the bytes
+        const uint64_t target = total * part / parts;
+        auto it = std::lower_bound(entries_.begin() + bounds.back(), entries_.end(), target,
+                                   [](const MessageEntry& entry, uint64_t offset) {
+                                       return entry.offset < offset;
+                                   });
+        const size_t first = it - entries_.begin();
+        if (first > bounds.back() && first < entries_.size()) {
+            bounds.push_back(first);
+        }
+    }
+    bounds.push_back(entries_.size());
+    return bounds;
+}
+
+uint64_t MessageIndex::TotalEvents() const {
+    uint64_t total = 0;
+    for (const MessageEntry& entry : entries_) {
+        total += entry.events;
+    }
+    return total;
+}
@@ -0,0 +1,67 @@
+#ifndef MESSAGEINDEX_H
+#define MESSAGEINDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct MessageEntry {
+    uint64_t offset;  // Byte offset of the message in the file
+    uint64_t length;  // Bytes on disk (packed or unpacked)
+    // Packet summary; zero until Describe() or Load() fills it in
+    uint32_t type = 0;
+    uint32_t events = 0;
+    uint64_t minTimeStamp = 0;
+    uint64_t maxTimeStamp = 0;
+};
+
+// Byte boundaries of every message in a .cap file.  For packed files the
+// boundaries are found by walking the packing tags and counting words, which
+// is much cheaper than unpacking and never builds a message.  With the index
+// the messages can be decoded independently and in parallel.
+//
+// Once every message is described (type, event count, time range) the index
+// can be saved as a .capidx sidecar next to the .cap file, so later readers
+// get totals, random packet access and partitions without a scan.
+class MessageIndex {
+public:
+    // Length of the message starting at data, or 0 if it is incomplete or
+    // malformed.  malformed, when given, tells the two apart: it is set if
+    // no amount of further bytes can complete the message.
+    static size_t PackedMessageLength(const void* data, size_t size, bool* malformed = nullptr);
+    static size_t UnpackedMessageLength(const void* data, size_t size, bool* malformed = nullptr);
+
+    // Indexes the whole buffer; false if it does not end on a message boundary
+    bool Build(const void* data, size_t size, bool packed);
+
+    // Sets the summary of message i.  Different messages may be described
+    // from different threads.
+    void Describe(size_t i, uint32_t type, uint32_t events,
+                  uint64_t minTimeStamp, uint64_t maxTimeStamp);
+
+    // "run.cap" -> "run.capidx"; other names get ".capidx" appended
+    static std::string SidecarPath(const std::string& capFile);
+    // Writes the sidecar of capFile, stamped with its size and modification
+    // time; false on a write error
+    bool Save(const std::string& capFile) const;
+    // Reads the sidecar of capFile; false if there is none, it is corrupt,
+    // or capFile changed since it was written
+    bool Load(const std::string& capFile);
+
+    // Splits the messages into at most parts contiguous ranges of about
+    // equal bytes; returns the first message of each range plus Size()
+    std::vector<size_t> Partition(size_t parts) const;
+
+    size_t Size() const { return entries_.size(); }
+    bool IsPacked() const { return packed_; }
+    uint64_t TotalEvents() const;
+    const MessageEntry& operator[](size_t i) const { return entries_[i]; }
+    const std::vector<MessageEntry>& Entries() const { return entries_; }
+
+private:
+    std::vector<MessageEntry> entries_;
+    bool packed_ = true;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "MultiFileSorter.h"
+#include "CapnpReader.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+MultiFileSorter::MultiFileSorter(const std::vector<std::string>& files, size_t memoryPerFile,
+                                 const std::string& tmpDir, unsigned readThreads)
+    : files_(files)
+    , memoryPerFile_(memoryPerFile)
+    , readThreads_(std::max(1u, std::min<unsigned>(readThreads, files.size())))
+{
+    for (size_t i = 0; i < files_.size(); i++) {
+        sorters_.push_back(std::make_unique<ExternalSorter>(memoryPerFile, tmpDir));
+    }
+}
+
+size_t MultiFileSorter::NumEvents() const {
+    size_t events = 0;
+    for (const auto& sorter : sorters_) {
+        events += sorter->NumEvents();
+    }
+    return events;
+}
+
+size_t MultiFileSorter::NumChunks() const {
+    size_t chunks = 0;
+    for (const auto& sorter : sorters_) {
+        chunks += sorter->NumChunks();
+    }
+    return chunks;
+}
+
+bool MultiFileSorter::ReadFile(size_t file) {
+    CapnpReader reader;
+    if (!reader.Open(files_[file])) {
+        return false;
+    }
+    reader.SetFilter(filter_);
+
+    ExternalSorter& sorter = *sorters_[file];
+    EventBatch packet;
+    size_t packets = 0;
+    while (reader.HasNext()) {
+        packet.Clear();
+        if (reader.ReadNextPacket(packet) == 0) {
+            continue;
+        }
+        sorter.Add(packet);
+        packets++;
+    }
+    reader.Close();
+
+    // Small tails stay in memory, larger ones are spilled, so the tails
+    // kept for the merge add up to at most one file's budget
+    if (sorter.BufferedBytes() > memoryPerFile_ / files_.size()) {
+        sorter.Flush();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    numPackets_ += packets;
+    return true;
+}
+
+bool MultiFileSorter::Read(const Progress& progress) {
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    auto worker = [&]() {
+        size_t file;
+        while (!failed && (file = next++) < files_.size()) {
+            try {
+                bool ok = ReadFile(file);
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!ok) {
+                    if (!failed.exchange(true)) {
+                        failedFile_ = files_[file];
+                    }
+                } else if (progress) {
+                    progress(files_[file], sorters_[file]->NumEvents());
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!failed.exchange(true)) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < readThreads_; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return failedFile_.empty();
+}
+
+void MultiFileSorter::Merge(const ExternalSorter::Sink& sink) {
+    // Heap entries are (timestamp, file); each sorter's current event stays
+    // valid until that sorter's Next() is called again
+    using Entry = std::pair<uint64_t, size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    std::vector<const EventBatch*> batches(sorters_.size());
+    std::vector<size_t> indices(sorters_.size());
+
+    // All sorters merge at once, so they share one file's budget, as the
+    // in-memory tails do
+    for (size_t file = 0; file < sorters_.size(); file++) {
+        sorters_[file]->BeginMerge(std::max<size_t>(1, memoryPerFile_ / files_.size()));
+        if (sorters_[file]->Next(batches[file], indices[file])) {
+            heap.emplace(batches[file]->TimeStamp[indices[file]], file);
+        }
+    }
+
+    while (!heap.empty()) {
+        size_t file = heap.top().second;
+        heap.pop();
+
+        sink(*batches[file], indices[file]);
+        if (sorters_[file]->Next(batches[file], indices[file])) {
+            heap.emplace(batches[file]->TimeStamp[indices[file]], file);
+        }
+    }
+}
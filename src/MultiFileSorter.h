@@ -0,0 +1,53 @@
+#ifndef MULTIFILESORTER_H
+#define MULTIFILESORTER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include "ExternalSorter.h"
+#include "EventFilter.h"
+
+// Time-orders the events of several input files (the parts of one run) into
+// a single stream.  Each file is decoded on a reader thread into its own
+// ExternalSorter, so reading holds at most one budget per reader thread, and
+// Merge() k-way merges the per-file sorted streams with the sorters sharing
+// a single budget.  Timestamp ties go to the earlier file, so
+// the result equals a stable sort of the files concatenated in order.
+class MultiFileSorter {
+public:
+    // Called once per file after it has been read, from a reader thread
+    // but never concurrently
+    using Progress = std::function<void(const std::string& file, size_t events)>;
+
+    MultiFileSorter(const std::vector<std::string>& files, size_t memoryPerFile,
+                    const std::string& tmpDir = "", unsigned readThreads = 1);
+
+    // Events the filter rejects are not read; set before Read()
+    void SetFilter(const EventFilter& filter) { filter_ = filter; }
+
+    // Reads every file; false if one cannot be opened (see FailedFile()).
+    // Spill errors are rethrown here.
+    bool Read(const Progress& progress = nullptr);
+    void Merge(const ExternalSorter::Sink& sink);
+
+    size_t NumEvents() const;
+    size_t NumChunks() const;
+    size_t NumPackets() const { return numPackets_; }
+    const std::string& FailedFile() const { return failedFile_; }
+
+private:
+    bool ReadFile(size_t file);
+
+    std::vector<std::string> files_;
+    std::vector<std::unique_ptr<ExternalSorter>> sorters_;
+    size_t memoryPerFile_;
+    unsigned readThreads_;
+    size_t numPackets_ = 0;
+    std::string failedFile_;
+    EventFilter filter_;
+    std::mutex mutex_;
+};
+
+#endif
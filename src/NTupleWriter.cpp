@@ -0,0 +1,79 @@
+#include "NTupleWriter.h"
+#include <ROOT/RNTupleWriteOptions.hxx>
+#include <algorithm>
+
+NTupleWriter::NTupleWriter(const std::string& filename, int compression) {
+    auto model = RNTupleAPI::RNTupleModel::Create();
+    mod_ = model->MakeField<uint8_t>("Mod");
+    ch_ = model->MakeField<uint8_t>("Ch");
+    timeStamp_ = model->MakeField<uint64_t>("TimeStamp");
+    fineTS_ = model->MakeField<double>("FineTS");
+    chargeLong_ = model->MakeField<uint16_t>("ChargeLong");
+    chargeShort_ = model->MakeField<uint16_t>("ChargeShort");
+    extras_ = model->MakeField<uint32_t>("Extras");
+    recordLength_ = model->MakeField<uint32_t>("RecordLength");
+    signal_ = model->MakeField<std::vector<uint16_t>>("Signal");
+
+    RNTupleAPI::RNTupleWriteOptions options;
+    options.SetCompression(compression);
+    writer_ = RNTupleAPI::RNTupleWriter::Recreate(std::move(model), "ELIADE_Tree",
+                                                  filename, options);
+}
+
+void NTupleWriter::Fill(const EventView& event) {
+    *mod_ = event.Mod;
+    *ch_ = event.Ch;
+    *timeStamp_ = event.TimeStamp;
+    *fineTS_ = event.FineTS;
+    *chargeLong_ = event.ChargeLong;
+    *chargeShort_ = event.ChargeShort;
+    *extras_ = event.Extras;
+    *recordLength_ = event.RecordLength;
+    SetSignal(event.Trace1, event.Trace1 ? event.RecordLength : 0, event.RecordLength);
+    writer_->Fill();
+}
+
+void NTupleWriter::FillBatch(const EventBatch& batch, size_t begin, size_t end,
+                             const std::vector<size_t>* order) {
+    if (!batch.HasTraces()) {
+        signal_->clear();
+        *recordLength_ = 0;
+    }
+    for (size_t row = begin; row < end; row++) {
+        FillRow(batch, order ? (*order)[row] : row);
+    }
+}
+
+void NTupleWriter::FillRow(const EventBatch& batch, size_t i) {
+    *mod_ = batch.Mod[i];
+    *ch_ = batch.Ch[i];
+    *timeStamp_ = batch.TimeStamp[i];
+    *fineTS_ = batch.FineTS[i];
+    *chargeLong_ = batch.ChargeLong[i];
+    *chargeShort_ = batch.ChargeShort[i];
+    *extras_ = batch.Extras[i];
+    if (batch.HasTraces()) {
+        *recordLength_ = batch.RecordLength[i];
+        SetSignal(batch.Trace1(i), batch.RecordLength[i], batch.RecordLength[i]);
+    }
+    writer_->Fill();
+}
+
+void NTupleWriter::SetSignal(const uint16_t* trace, size_t samples, uint32_t recordLength) {
+    // The field value is reused, so after the first events this copies into
+    // existing capacity; short traces are zero-padded to RecordLength
+    samples = std::min<size_t>(samples, recordLength);
+    signal_->assign(trace, trace + samples);
+    signal_->resize(recordLength, 0);
+}
+
+void NTupleWriter::Flush() {
+    if (writer_) {
+        writer_->CommitCluster();
+    }
+}
+
+void NTupleWriter::Close() {
+    // Destroying the writer commits the last cluster and the footer
+    writer_.reset();
+}
@@ -0,0 +1,54 @@
+#ifndef NTUPLEWRITER_H
+#define NTUPLEWRITER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <RVersion.h>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+#include "EventWriter.h"
+
+// The RNTuple API left ROOT::Experimental in 6.36
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6, 36, 0)
+namespace RNTupleAPI = ROOT;
+#else
+namespace RNTupleAPI = ROOT::Experimental;
+#endif
+
+// Writes the events as an RNTuple named ELIADE_Tree.  Signal is a
+// std::vector<uint16_t> field holding RecordLength samples per event.
+class NTupleWriter : public EventWriter {
+public:
+    // compression is a ROOT compression setting, as for RootWriter
+    explicit NTupleWriter(const std::string& filename, int compression = 101);
+    ~NTupleWriter() override { Close(); }
+
+    void Fill(const EventView& event) override;
+    void FillBatch(const EventBatch& batch, size_t begin, size_t end,
+                   const std::vector<size_t>* order = nullptr) override;
+    using EventWriter::FillBatch;
+
+    // Commits the current cluster.  Readers see the data only after
+    // Close(), which writes the RNTuple footer.
+    void Flush() override;
+    void Close() override;
+
+private:
+    void FillRow(const EventBatch& batch, size_t i);
+    void SetSignal(const uint16_t* trace, size_t samples, uint32_t recordLength);
+
+    std::unique_ptr<RNTupleAPI::RNTupleWriter> writer_;
+    std::shared_ptr<uint8_t> mod_;
+    std::shared_ptr<uint8_t> ch_;
+    std::shared_ptr<uint64_t> timeStamp_;
+    std::shared_ptr<double> fineTS_;
+    std::shared_ptr<uint16_t> chargeLong_;
+    std::shared_ptr<uint16_t> chargeShort_;
+    std::shared_ptr<uint32_t> extras_;
+    std::shared_ptr<uint32_t> recordLength_;
+    std::shared_ptr<std::vector<uint16_t>> signal_;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef PACKETTRAITS_H
+#define PACKETTRAITS_H
+
+#include "eventProto.capnp.h"
+
+// Which optional fields the events of each packet type carry.  Decoding
+// (CapnpReader) and generation (EventGenerator) are written once against
+// these traits, so a new packet type needs one entry here and one case in
+// ForPacketType().
+template <typename Data> struct PacketTraits;
+
+template <> struct PacketTraits<PlainData> {
+    static constexpr int waveforms = 0;
+    static constexpr bool psd = false, fineTime = false, triggers = false;
+};
+template <> struct PacketTraits<PsdData> {
+    static constexpr int waveforms = 0;
+    static constexpr bool psd = true, fineTime = false, triggers = false;
+};
+template <> struct PacketTraits<WaveData> {
+    static constexpr int waveforms = 1;
+    static constexpr bool psd = false, fineTime = false, triggers = false;
+};
+template <> struct PacketTraits<DualWaveData> {
+    static constexpr int waveforms = 2;
+    static constexpr bool psd = false, fineTime = false, triggers = false;
+};
+template <> struct PacketTraits<FullData> {
+    static constexpr int waveforms = 2;
+    static constexpr bool psd = true, fineTime = false, triggers = false;
+};
+template <> struct PacketTraits<RawTimeData> {
+    static constexpr int waveforms = 0;
+    static constexpr bool psd = false, fineTime = true, triggers = false;
+};
+template <> struct PacketTraits<CrossData> {
+    static constexpr int waveforms = 0;
+    static constexpr bool psd = false, fineTime = false, triggers = true;
+};
+template <> struct PacketTraits<PsdWaveData> {
+    static constexpr int waveforms = 1;
+    static constexpr bool psd = true, fineTime = false, triggers = false;
+};
+
+template <typename Data> struct PacketTag {
+    using type = Data;
+};
+
+// Calls fn(PacketTag<Data>()) with the packet struct of a type field value;
+// false if the type is unknown
+template <typename Fn>
+bool ForPacketType(int type, Fn&& fn) {
+    switch (type) {
+        case 0: fn(PacketTag<PlainData>()); return true;
+        case 1: fn(PacketTag<PsdData>()); return true;
+        case 2: fn(PacketTag<WaveData>()); return true;
+        case 3: fn(PacketTag<DualWaveData>()); return true;
+        case 4: fn(PacketTag<FullData>()); return true;
+        case 5: fn(PacketTag<RawTimeData>()); return true;
+        case 6: fn(PacketTag<CrossData>()); return true;
+        case 7: fn(PacketTag<PsdWaveData>()); return true;
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,188 @@
+#include "ParallelDecoder.h"
+#include "CapnpReader.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+ParallelDecoder::ParallelDecoder(unsigned threads)
+    : threads_(threads > 0 ? threads : 1)
+{
+}
+
+bool ParallelDecoder::Open(const std::string& filename) {
+    Close();
+
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        Close();
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    if (size_ > 0) {
+        void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (addr == MAP_FAILED) {
+            Close();
+            return false;
+        }
+        data_ = static_cast<const uint8_t*>(addr);
+    }
+
+    described_ = false;
+    fromSidecar_ = index_.Load(filename);
+    if (fromSidecar_) {
+        packed_ = index_.IsPacked();
+        bounded_ = true;
+        return true;
+    }
+
+    packed_ = !CapnpReader::IsUnpackedFraming(data_, size_);
+    bounded_ = index_.Build(data_, size_, packed_);
+    if (!bounded_) {
+        // Keep the complete messages; a truncated tail is dropped just as
+        // the sequential reader stops at the first unreadable message
+        std::cerr << "Warning: " << filename << " ends with an incomplete message\n";
+    }
+
+    return true;
+}
+
+void ParallelDecoder::Close() {
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+size_t ParallelDecoder::Run(const std::function<void(EventBatch&)>& sink) {
+    const size_t window = 4 * static_cast<size_t>(threads_);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::unique_ptr<EventBatch>> slots(window);
+    size_t nextToDecode = 0;
+    size_t delivered = 0;
+    // Like the sequential reader, stop at the first message that cannot be
+    // decoded; everything before it is still delivered
+    size_t stopAt = index_.Size();
+    const EventFilter* filter = filter_.IsActive() ? &filter_ : nullptr;
+    const bool skipByTime = fromSidecar_ && filter_.HasTimeRange();
+
+    auto worker = [&]() {
+        while (true) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return nextToDecode < delivered + window || nextToDecode >= stopAt; });
+                if (nextToDecode >= stopAt) {
+                    return;
+                }
+                i = nextToDecode++;
+            }
+
+            auto batch = std::make_unique<EventBatch>();
+            bool ok = true;
+            try {
+                const MessageEntry& entry = index_[i];
+                // A packet outside the time range stays an empty batch
+                if (!skipByTime || filter_.OverlapsTime(entry.minTimeStamp, entry.maxTimeStamp)) {
+                    int type = 0;
+                    CapnpReader::DecodeBytes(data_ + entry.offset, entry.length, packed_, *batch,
+                                             filter, &type);
+                    // Filtered batches do not describe the whole packet
+                    if (!filter) {
+                        uint64_t minTs = 0, maxTs = 0;
+                        if (!batch->Empty()) {
+                            auto range = std::minmax_element(batch->TimeStamp.begin(),
+                                                             batch->TimeStamp.end());
+                            minTs = *range.first;
+                            maxTs = *range.second;
+                        }
+                        index_.Describe(i, type, batch->Size(), minTs, maxTs);
+                    }
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Warning: cannot decode message " << i << ": " << e.what() << "\n";
+                ok = false;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ok) {
+                    slots[i % window] = std::move(batch);
+                } else if (i < stopAt) {
+                    stopAt = i;
+                }
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads_; t++) {
+        workers.emplace_back(worker);
+    }
+
+    auto shutdown = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopAt = 0;
+        }
+        cv.notify_all();
+        for (auto& thread : workers) {
+            thread.join();
+        }
+    };
+
+    try {
+        while (true) {
+            std::unique_ptr<EventBatch> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return slots[delivered % window] || delivered >= stopAt; });
+                if (delivered >= stopAt) {
+                    break;
+                }
+                batch = std::move(slots[delivered % window]);
+            }
+
+            sink(*batch);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                delivered++;
+            }
+            cv.notify_all();
+        }
+    } catch (...) {
+        shutdown();
+        throw;
+    }
+
+    shutdown();
+    described_ = bounded_ && !filter && delivered == index_.Size();
+    return delivered;
+}
+
+bool ParallelDecoder::SaveIndex(const std::string& filename) const {
+    return described_ && index_.Save(filename);
+}
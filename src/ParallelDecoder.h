@@ -0,0 +1,51 @@
+#ifndef PARALLELDECODER_H
+#define PARALLELDECODER_H
+
+#include <string>
+#include <functional>
+#include "EventBatch.h"
+#include "MessageIndex.h"
+#include "EventFilter.h"
+
+// Decodes a .cap file on several threads.  The file is memory-mapped and a
+// MessageIndex of the message boundaries is built first; workers then decode
+// messages independently while Run() hands the resulting batches to the sink
+// in file order.  At most a small window of decoded packets is held at once.
+// A current .capidx sidecar replaces the boundary scan, and a run that
+// decodes the whole file describes every message, so SaveIndex() can write
+// the sidecar as a by-product of the conversion.  With a filter set, events
+// it rejects are dropped while decoding and, given a sidecar, packets
+// outside its time range are delivered empty without being unpacked.
+class ParallelDecoder {
+public:
+    explicit ParallelDecoder(unsigned threads);
+    ~ParallelDecoder() { Close(); }
+
+    bool Open(const std::string& filename);
+    void Close();
+    void SetFilter(const EventFilter& filter) { filter_ = filter; }
+
+    // Returns the number of packets delivered
+    size_t Run(const std::function<void(EventBatch&)>& sink);
+
+    const MessageIndex& Index() const { return index_; }
+    bool IsPacked() const { return packed_; }
+    bool FromSidecar() const { return fromSidecar_; }
+    // Writes the sidecar index of filename; false unless the last Run()
+    // decoded every message of a complete file without a filter
+    bool SaveIndex(const std::string& filename) const;
+
+private:
+    unsigned threads_;
+    int fd_ = -1;
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool packed_ = true;
+    bool bounded_ = false;      // The file ends on a message boundary
+    bool fromSidecar_ = false;
+    bool described_ = false;    // Every message described by Run()
+    MessageIndex index_;
+    EventFilter filter_;
+};
+
+#endif
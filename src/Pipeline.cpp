@@ -0,0 +1,172 @@
+#include "Pipeline.h"
+#include "CapnpReader.h"
+#include "MessageIndex.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+using RawMessage = std::unique_ptr<std::vector<uint8_t>>;
+using DecodedPacket = std::unique_ptr<EventBatch>;
+
+const size_t kReadChunk = 4 * 1024 * 1024;
+
+}  // namespace
+
+Pipeline::Pipeline(unsigned decoders, size_t queueDepth)
+    : decoders_(decoders > 0 ? decoders : 1)
+    , queueDepth_(queueDepth)
+{
+}
+
+long Pipeline::Run(const std::string& filename, const std::function<void(EventBatch&)>& sink) {
+    const bool packed = !CapnpReader::IsUnpackedFile(filename);
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    const EventFilter* filter = filter_.IsActive() ? &filter_ : nullptr;
+    std::atomic<bool> abort{false};
+    std::vector<std::unique_ptr<SpscQueue<RawMessage>>> rawQueues;
+    std::vector<std::unique_ptr<SpscQueue<DecodedPacket>>> decodedQueues;
+    for (unsigned d = 0; d < decoders_; d++) {
+        rawQueues.push_back(std::make_unique<SpscQueue<RawMessage>>(queueDepth_));
+        decodedQueues.push_back(std::make_unique<SpscQueue<DecodedPacket>>(queueDepth_));
+    }
+
+    // I/O stage: read big chunks, cut complete messages, deal them out.
+    // A null message tells each decoder that the input has ended.
+    std::thread reader([&]() {
+        std::vector<uint8_t> buffer(kReadChunk);
+        size_t start = 0;
+        size_t end = 0;
+        // File offset of buffer[0]
+        uint64_t offset = 0;
+        unsigned next = 0;
+        bool eof = false;
+        bool malformed = false;
+
+        while (!eof && !malformed && !abort.load()) {
+            ssize_t n = read(fd, buffer.data() + end, buffer.size() - end);
+            if (n <= 0) {
+                eof = true;
+            } else {
+                end += static_cast<size_t>(n);
+            }
+
+            while (start < end) {
+                size_t length = packed ? MessageIndex::PackedMessageLength(buffer.data() + start, end - start,
+                                                                           &malformed)
+                                       : MessageIndex::UnpackedMessageLength(buffer.data() + start, end - start,
+                                                                             &malformed);
+                if (length == 0) {
+                    break;
+                }
+                RawMessage message = std::make_unique<std::vector<uint8_t>>(
+                    buffer.begin() + start, buffer.begin() + start + length);
+                if (!rawQueues[next]->Push(message, abort)) {
+                    return;
+                }
+                next = (next + 1) % decoders_;
+                start += length;
+            }
+
+            // Keep the partial message and make room for the next read
+            if (malformed) {
+                break;
+            }
+            if (start > 0) {
+                std::memmove(buffer.data(), buffer.data() + start, end - start);
+                end -= start;
+                offset += start;
+                start = 0;
+            }
+            if (end == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+        }
+
+        // Like the other readers, everything before the bad message is kept
+        if (malformed) {
+            std::cerr << "Error: " << filename << " has a malformed message at byte "
+                      << offset + start << "\n";
+        } else if (end > start) {
+            std::cerr << "Warning: " << filename << " ends with an incomplete message\n";
+        }
+
+        // End-of-stream markers follow the round-robin order, so the sink
+        // stops exactly after the last message
+        for (unsigned d = 0; d < decoders_; d++) {
+            RawMessage done;
+            if (!rawQueues[(next + d) % decoders_]->Push(done, abort)) {
+                return;
+            }
+        }
+    });
+
+    // Decode stage.  A message that cannot be decoded ends this decoder's
+    // stream early; since the sink collects round-robin it stops right after
+    // the last good message, as the sequential reader does.
+    std::vector<std::thread> decoders;
+    for (unsigned d = 0; d < decoders_; d++) {
+        decoders.emplace_back([&, d]() {
+            RawMessage message;
+            while (rawQueues[d]->Pop(message, abort)) {
+                DecodedPacket packet;
+                if (message) {
+                    packet = std::make_unique<EventBatch>();
+                    try {
+                        CapnpReader::DecodeBytes(message->data(), message->size(), packed, *packet,
+                                                 filter);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Warning: cannot decode message: " << e.what() << "\n";
+                        packet.reset();
+                    }
+                }
+                bool done = !packet;
+                if (!decodedQueues[d]->Push(packet, abort) || done) {
+                    return;
+                }
+            }
+        });
+    }
+
+    // Write stage, on the calling thread
+    long delivered = 0;
+    auto shutdown = [&]() {
+        reader.join();
+        for (auto& thread : decoders) {
+            thread.join();
+        }
+        close(fd);
+    };
+
+    try {
+        unsigned next = 0;
+        DecodedPacket packet;
+        while (decodedQueues[next]->Pop(packet, abort) && packet) {
+            next = (next + 1) % decoders_;
+            if (packet->Empty()) {
+                continue;
+            }
+            sink(*packet);
+            delivered++;
+        }
+    } catch (...) {
+        abort = true;
+        shutdown();
+        throw;
+    }
+
+    abort = true;
+    shutdown();
+    return delivered;
+}
@@ -0,0 +1,34 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <string>
+#include <functional>
+#include "EventBatch.h"
+#include "EventFilter.h"
+
+// Streams a .cap file through three overlapping stages: an I/O thread reads
+// the file and cuts it into raw messages, decoder threads turn messages into
+// EventBatches, and the calling thread hands them to the sink (normally the
+// RootWriter).  Stages are connected by bounded lock-free queues, so a slow
+// writer throttles reading instead of letting memory grow.  Messages are
+// dealt to the decoders round-robin and collected in the same order, so the
+// sink sees packets in file order.
+class Pipeline {
+public:
+    explicit Pipeline(unsigned decoders, size_t queueDepth = 8);
+
+    // Events the filter rejects are dropped by the decoders
+    void SetFilter(const EventFilter& filter) { filter_ = filter; }
+
+    // Returns the number of packets delivered, or -1 if the file cannot be
+    // opened.  Like CapnpReader, delivery stops at the first message that
+    // is malformed or cannot be decoded.
+    long Run(const std::string& filename, const std::function<void(EventBatch&)>& sink);
+
+private:
+    unsigned decoders_;
+    size_t queueDepth_;
+    EventFilter filter_;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "ReorderBuffer.h"
+#include <algorithm>
+
+namespace {
+
+// True if newest is more than window ticks ahead of ts; written without
+// adding so that huge windows cannot wrap
+bool Passed(uint64_t ts, uint64_t window, uint64_t newest) {
+    return ts < newest && newest - ts > window;
+}
+
+}  // namespace
+
+ReorderBuffer::ReorderBuffer(uint64_t window)
+    : window_(window) {
+}
+
+void ReorderBuffer::Add(EventBatch& packet) {
+    if (packet.Empty()) {
+        return;
+    }
+
+    const uint64_t sequence = firstPacket_ + packets_.size();
+    for (size_t i = 0; i < packet.Size(); i++) {
+        const uint64_t ts = packet.TimeStamp[i];
+        if (Passed(ts, window_, newest_)) {
+            violations_++;
+        }
+        newest_ = std::max(newest_, ts);
+        heap_.push_back({ts, arrivals_++, sequence, i});
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+    }
+
+    remaining_.push_back(packet.Size());
+    packets_.push_back(std::move(packet));
+    packet.Clear();
+}
+
+size_t ReorderBuffer::Emit(const Sink& sink) {
+    return Drain(sink, false);
+}
+
+size_t ReorderBuffer::Flush(const Sink& sink) {
+    return Drain(sink, true);
+}
+
+size_t ReorderBuffer::Drain(const Sink& sink, bool all) {
+    size_t emitted = 0;
+    while (!heap_.empty()) {
+        const Entry& top = heap_.front();
+        if (!all && !Passed(top.timeStamp, window_, newest_)) {
+            break;
+        }
+
+        const size_t slot = top.packet - firstPacket_;
+        sink(packets_[slot], top.index);
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+        heap_.pop_back();
+        remaining_[slot]--;
+        emitted++;
+
+        // Packets are released in arrival order once fully emitted
+        while (!remaining_.empty() && remaining_.front() == 0) {
+            remaining_.pop_front();
+            packets_.pop_front();
+            firstPacket_++;
+        }
+    }
+    return emitted;
+}
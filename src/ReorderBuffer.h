@@ -0,0 +1,61 @@
+#ifndef REORDERBUFFER_H
+#define REORDERBUFFER_H
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include "EventBatch.h"
+
+// Bounded reordering for streams that are time-ordered up to a known
+// window: an event is emitted once an event more than `window` ticks newer
+// has been seen, so only the last window's events are held.  Pending events
+// sit in a min-heap on (timestamp, arrival), which keeps ties in arrival
+// order; each Add/emit costs O(log w) for w pending events.
+//
+// Events arriving more than the window behind the newest timestamp are
+// counted as violations.  They are still emitted, at the next Emit(), and
+// may then be out of order.
+class ReorderBuffer {
+public:
+    using Sink = std::function<void(const EventBatch&, size_t)>;
+
+    explicit ReorderBuffer(uint64_t window);
+
+    // Takes over the events of packet, which is left empty
+    void Add(EventBatch& packet);
+    // Emits, in timestamp order, the events the window has passed
+    size_t Emit(const Sink& sink);
+    // Emits everything still pending, e.g. at the end of the input
+    size_t Flush(const Sink& sink);
+
+    uint64_t Window() const { return window_; }
+    size_t Pending() const { return heap_.size(); }
+    uint64_t NumViolations() const { return violations_; }
+
+private:
+    struct Entry {
+        uint64_t timeStamp;
+        uint64_t arrival;
+        uint64_t packet;   // Sequence number of the packet holding it
+        size_t index;
+        bool operator>(const Entry& other) const {
+            return timeStamp != other.timeStamp ? timeStamp > other.timeStamp
+                                                : arrival > other.arrival;
+        }
+    };
+
+    size_t Drain(const Sink& sink, bool all);
+
+    uint64_t window_;
+    std::vector<Entry> heap_;
+    std::deque<EventBatch> packets_;
+    std::deque<size_t> remaining_;   // Pending events per packet
+    uint64_t firstPacket_ = 0;       // Sequence number of packets_.front()
+    uint64_t arrivals_ = 0;
+    uint64_t newest_ = 0;
+    uint64_t violations_ = 0;
+};
+
+#endif
@@ -1,12 +1,15 @@
 #include "RootWriter.h"
+#include "TROOT.h"
+#include "Compression.h"
+#include <algorithm>
 
-RootWriter::RootWriter(const std::string &filename)
+RootWriter::RootWriter(const std::string &filename, int compression)
 {
   file_ = std::make_unique<TFile>(filename.c_str(), "RECREATE");
 
-  // Set compression level (0=none, 1=fastest, 9=best compression)
-  // Using level 1 for fast compression
-  file_->SetCompressionLevel(1);
+  // Algorithm and level (0=none, 1=fastest, 9=best compression) in one
+  // setting, e.g. 101 = ZLIB:1, 404 = LZ4:4, 505 = ZSTD:5
+  file_->SetCompressionSettings(compression);
 
   tree_ = new TTree("ELIADE_Tree", "Converted data from ROSPHER");
 
@@ -23,18 +26,114 @@ RootWriter::RootWriter(const std::string &filename)
   tree_->Branch("FineTS", &data_.FineTS, "FineTS/D", basketSize);
   tree_->Branch("ChargeLong", &data_.ChargeLong, "ChargeLong/s", basketSize);
   tree_->Branch("ChargeShort", &data_.ChargeShort, "ChargeShort/s", basketSize);
+  tree_->Branch("Extras", &data_.Extras, "Extras/i", basketSize);
   tree_->Branch("RecordLength", &data_.RecordLength, "RecordLength/i",
                 basketSize);
-  tree_->Branch("Signal", data_.Trace1.data(), "Signal[RecordLength]/s",
-                basketSize);
+  // Signal is rebound to each event's trace in BindSignal()
+  signal_ = tree_->Branch("Signal", &emptySignal_, "Signal[RecordLength]/s",
+                          basketSize);
+  boundSignal_ = &emptySignal_;
 }
 
 void RootWriter::Fill(const TreeData &data)
 {
-  data_ = data;
+  data_.Mod = data.Mod;
+  data_.Ch = data.Ch;
+  data_.TimeStamp = data.TimeStamp;
+  data_.FineTS = data.FineTS;
+  data_.ChargeLong = data.ChargeLong;
+  data_.ChargeShort = data.ChargeShort;
+  data_.Extras = data.Extras;
+  data_.RecordLength = data.RecordLength;
+  BindSignal(data.Trace1.data(), data.Trace1.size());
+  tree_->Fill();
+}
+
+void RootWriter::Fill(const EventView &event)
+{
+  data_.Mod = event.Mod;
+  data_.Ch = event.Ch;
+  data_.TimeStamp = event.TimeStamp;
+  data_.FineTS = event.FineTS;
+  data_.ChargeLong = event.ChargeLong;
+  data_.ChargeShort = event.ChargeShort;
+  data_.Extras = event.Extras;
+  data_.RecordLength = event.RecordLength;
+  BindSignal(event.Trace1, event.Trace1 ? event.RecordLength : 0);
   tree_->Fill();
 }
 
+void RootWriter::FillBatch(const EventBatch &batch, size_t begin, size_t end,
+                           const std::vector<size_t> *order)
+{
+  // Resolve the trace and order cases once, not per event
+  auto identity = [](size_t i) { return i; };
+  auto permuted = [order](size_t i) { return (*order)[i]; };
+
+  if (batch.HasTraces()) {
+    if (order) {
+      FillRows<true>(batch, begin, end, permuted);
+    } else {
+      FillRows<true>(batch, begin, end, identity);
+    }
+  } else {
+    data_.RecordLength = 0;
+    BindSignal(nullptr, 0);
+    if (order) {
+      FillRows<false>(batch, begin, end, permuted);
+    } else {
+      FillRows<false>(batch, begin, end, identity);
+    }
+  }
+}
+
+template <bool Traces, typename Index>
+void RootWriter::FillRows(const EventBatch &batch, size_t begin, size_t end, Index index)
+{
+  for (size_t row = begin; row < end; row++) {
+    const size_t i = index(row);
+    data_.Mod = batch.Mod[i];
+    data_.Ch = batch.Ch[i];
+    data_.TimeStamp = batch.TimeStamp[i];
+    data_.FineTS = batch.FineTS[i];
+    data_.ChargeLong = batch.ChargeLong[i];
+    data_.ChargeShort = batch.ChargeShort[i];
+    data_.Extras = batch.Extras[i];
+    if (Traces) {
+      data_.RecordLength = batch.RecordLength[i];
+      BindSignal(batch.Samples.data() + batch.TraceOffset[i], data_.RecordLength);
+    }
+    tree_->Fill();
+  }
+}
+
+void RootWriter::BindSignal(const uint16_t *trace, size_t samples)
+{
+  // TTree::Fill reads RecordLength samples from the bound address, so a
+  // short trace goes through a zero-padded copy instead
+  const uint16_t *address = trace;
+  if (samples < data_.RecordLength) {
+    padding_.assign(data_.RecordLength, 0);
+    std::copy(trace, trace + samples, padding_.begin());
+    address = padding_.data();
+  } else if (data_.RecordLength == 0) {
+    address = &emptySignal_;
+  }
+
+  // SetAddress only when the storage moved; ROOT reads it at Fill time
+  if (address != boundSignal_) {
+    signal_->SetAddress(const_cast<uint16_t *>(address));
+    boundSignal_ = address;
+  }
+}
+
+void RootWriter::Flush()
+{
+  if (file_ && file_->IsOpen()) {
+    tree_->AutoSave("SaveSelf;FlushBaskets");
+  }
+}
+
 void RootWriter::Close()
 {
   if (file_ && file_->IsOpen()) {
@@ -42,3 +141,56 @@ void RootWriter::Close()
     file_->Close();
   }
 }
+
+void RootWriter::EnableParallelCompression(unsigned threads)
+{
+  // Implicit MT keeps Fill() single-threaded and in entry order; only the
+  // basket compression at each AutoFlush is spread over the thread pool.
+  // TBufferMerger is not used because its independently filled buffers are
+  // merged in completion order, which would break the timestamp ordering.
+  if (threads > 1) {
+    ROOT::EnableImplicitMT(threads);
+  }
+}
+
+bool RootWriter::ParseCompression(const std::string &spec, int &compression)
+{
+  using Algorithm = ROOT::RCompressionSetting::EAlgorithm;
+
+  if (spec == "none" || spec == "0") {
+    compression = 0;
+    return true;
+  }
+
+  std::string name = spec.substr(0, spec.find(':'));
+  int level = -1;
+  if (name.size() < spec.size()) {
+    const std::string levelText = spec.substr(name.size() + 1);
+    if (levelText.size() != 1 || levelText[0] < '0' || levelText[0] > '9') {
+      return false;
+    }
+    level = levelText[0] - '0';
+  }
+
+  Algorithm::EValues algorithm;
+  int defaultLevel;
+  if (name == "zlib") {
+    algorithm = Algorithm::kZLIB;
+    defaultLevel = 1;
+  } else if (name == "lz4") {
+    algorithm = Algorithm::kLZ4;
+    defaultLevel = 4;
+  } else if (name == "zstd") {
+    algorithm = Algorithm::kZSTD;
+    defaultLevel = 5;
+  } else if (name == "lzma") {
+    algorithm = Algorithm::kLZMA;
+    defaultLevel = 7;
+  } else {
+    return false;
+  }
+
+  // Level 0 means uncompressed for every algorithm
+  compression = ROOT::CompressionSettings(algorithm, level < 0 ? defaultLevel : level);
+  return true;
+}
@@ -6,19 +6,56 @@
 #include "TFile.h"
 #include "TTree.h"
 #include "../TreeData.h"
+#include "EventBatch.h"
+#include "EventWriter.h"
 
-class RootWriter {
+// Writes the classic ELIADE_Tree TTree
+class RootWriter : public EventWriter {
 public:
-    explicit RootWriter(const std::string& filename);
-    ~RootWriter() { Close(); }
+    // compression is a ROOT compression setting (100 * algorithm + level);
+    // the default is ZLIB level 1
+    explicit RootWriter(const std::string& filename, int compression = 101);
+    ~RootWriter() override { Close(); }
 
+    // Both overloads copy only the scalar fields; the Signal branch reads
+    // Trace1 straight from the caller's storage, which must stay valid for
+    // the duration of the call.  Traces shorter than RecordLength are
+    // zero-padded.
     void Fill(const TreeData& data);
-    void Close();
+    void Fill(const EventView& event) override;
+
+    // Writes batch events [begin, end), or batch[order[begin]] ...
+    // batch[order[end - 1]] when an order is given, reading the columns
+    // directly.  Batches without traces skip the Signal rebinding entirely.
+    void FillBatch(const EventBatch& batch, size_t begin, size_t end,
+                   const std::vector<size_t>* order = nullptr) override;
+    using EventWriter::FillBatch;
+
+    // AutoSave: flushes the baskets and rewrites the tree header, which
+    // makes the entries so far visible to readers of the file
+    void Flush() override;
+    void Close() override;
+
+    // Compresses baskets on a pool of `threads` ROOT threads when the tree
+    // flushes a cluster.  Process-wide; call before creating writers.
+    static void EnableParallelCompression(unsigned threads);
+
+    // Parses "lz4:4", "zstd:5", "zlib:1", "lzma:7" or "none" into a ROOT
+    // compression setting.  A missing level means the algorithm's default.
+    static bool ParseCompression(const std::string& spec, int& compression);
 
 private:
+    void BindSignal(const uint16_t* trace, size_t samples);
+    template <bool Traces, typename Index>
+    void FillRows(const EventBatch& batch, size_t begin, size_t end, Index index);
+
     std::unique_ptr<TFile> file_;
     TTree* tree_;  // Owned by TFile, don't delete
-    TreeData data_;
+    TBranch* signal_;  // Owned by tree_
+    const uint16_t* boundSignal_;
+    uint16_t emptySignal_ = 0;
+    std::vector<uint16_t> padding_;
+    TreeData data_;  // Scalar branch storage only
 };
 
 #endif
@@ -0,0 +1,86 @@
+#include "RunMerger.h"
+#include <algorithm>
+#include <queue>
+#include <tuple>
+
+RunMerger::RunMerger(size_t maxRunsPerStream)
+    : maxRunsPerStream_(maxRunsPerStream)
+{
+}
+
+void RunMerger::Observe(const EventBatch& batch, size_t begin) {
+    for (size_t i = begin; i < batch.Size(); i++) {
+        uint16_t key = static_cast<uint16_t>((batch.Mod[i] << 8) | batch.Ch[i]);
+        Stream& stream = streams_[key];
+
+        // A timestamp going backwards starts a new ascending run
+        if (stream.events.empty() || batch.TimeStamp[i] < batch.TimeStamp[stream.events.back()]) {
+            stream.runStarts.push_back(stream.events.size());
+        }
+        stream.events.push_back(i);
+    }
+}
+
+size_t RunMerger::NumRuns() const {
+    size_t runs = 0;
+    for (const auto& item : streams_) {
+        runs += item.second.runStarts.size();
+    }
+    return runs;
+}
+
+std::vector<size_t> RunMerger::Merge(const EventBatch& batch) {
+    const auto& ts = batch.TimeStamp;
+
+    struct Cursor {
+        const size_t* pos;
+        const size_t* end;
+    };
+    std::vector<Cursor> cursors;
+
+    for (auto& item : streams_) {
+        Stream& stream = item.second;
+
+        // Too fragmented to be worth merging run by run
+        if (stream.runStarts.size() > maxRunsPerStream_) {
+            std::stable_sort(stream.events.begin(), stream.events.end(),
+                             [&ts](size_t a, size_t b) {
+                                 return ts[a] < ts[b];
+                             });
+            stream.runStarts.assign(1, 0);
+            sortedStreams_++;
+        }
+
+        const size_t* base = stream.events.data();
+        for (size_t r = 0; r < stream.runStarts.size(); r++) {
+            size_t end = (r + 1 < stream.runStarts.size()) ? stream.runStarts[r + 1]
+                                                           : stream.events.size();
+            cursors.push_back({base + stream.runStarts[r], base + end});
+        }
+    }
+
+    // Heap entries are (timestamp, batch index, cursor)
+    using HeapEntry = std::tuple<uint64_t, size_t, size_t>;
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> heap;
+
+    for (size_t c = 0; c < cursors.size(); c++) {
+        heap.emplace(ts[*cursors[c].pos], *cursors[c].pos, c);
+    }
+
+    std::vector<size_t> order;
+    order.reserve(batch.Size());
+
+    while (!heap.empty()) {
+        size_t index = std::get<1>(heap.top());
+        size_t c = std::get<2>(heap.top());
+        heap.pop();
+
+        order.push_back(index);
+        if (++cursors[c].pos < cursors[c].end) {
+            heap.emplace(ts[*cursors[c].pos], *cursors[c].pos, c);
+        }
+    }
+
+    streams_.clear();
+    return order;
+}
@@ -0,0 +1,37 @@
+#ifndef RUNMERGER_H
+#define RUNMERGER_H
+
+#include <vector>
+#include <unordered_map>
+#include "EventBatch.h"
+
+// Timestamp ordering that exploits the digitizer streams being (nearly)
+// time-ordered per (Mod, Ch).  As packets are appended to the batch, Observe()
+// splits each stream into ascending runs; Merge() then k-way merges all runs
+// with a heap and returns the event order.  A stream that breaks into too
+// many runs is stable-sorted instead.  Ties are broken by batch index, so the
+// result equals EventBatch::StableTimeOrder().
+class RunMerger {
+public:
+    explicit RunMerger(size_t maxRunsPerStream = 16);
+
+    // Scans events [begin, batch.Size()) that were just appended
+    void Observe(const EventBatch& batch, size_t begin);
+    std::vector<size_t> Merge(const EventBatch& batch);
+
+    size_t NumStreams() const { return streams_.size(); }
+    size_t NumRuns() const;
+    size_t NumSortedStreams() const { return sortedStreams_; }
+
+private:
+    struct Stream {
+        std::vector<size_t> events;
+        std::vector<size_t> runStarts;
+    };
+
+    size_t maxRunsPerStream_;
+    size_t sortedStreams_ = 0;
+    std::unordered_map<uint16_t, Stream> streams_;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SAMPLECOPY_H
+#define SAMPLECOPY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Copies count samples of a capnp List(Int16) from its raw list bytes into
+// uint16 trace storage.  Cap'n Proto stores the list as contiguous
+// little-endian int16, which on a little-endian host is already the bit
+// pattern of the uint16 trace, so the copy is one memcpy; libc picks its
+// SSE2/AVX2 variant at run time.  Big-endian hosts assemble each sample.
+inline void CopySamples(const uint8_t* data, size_t count, uint16_t* out) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::memcpy(out, data, count * sizeof(uint16_t));
+#else
+    for (size_t i = 0; i < count; i++) {
+        out[i] = static_cast<uint16_t>(data[2 * i] | data[2 * i + 1] << 8);
+    }
+#endif
+}
+
+#endif
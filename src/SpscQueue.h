@@ -0,0 +1,84 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free single-producer/single-consumer ring buffer.  Push() and
+// Pop() block (spin, then yield, then sleep) while the queue is full or
+// empty, which is what gives the pipeline its backpressure.  Both return
+// false once the shared abort flag is raised.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    bool TryPush(T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_) {
+            return false;
+        }
+        slots_[tail & mask_] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Push(T& item, const std::atomic<bool>& abort) {
+        for (unsigned spins = 0; !TryPush(item); spins++) {
+            if (abort.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            Backoff(spins);
+        }
+        return true;
+    }
+
+    bool Pop(T& item, const std::atomic<bool>& abort) {
+        for (unsigned spins = 0; !TryPop(item); spins++) {
+            if (abort.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            Backoff(spins);
+        }
+        return true;
+    }
+
+private:
+    static void Backoff(unsigned spins) {
+        if (spins < 64) {
+            return;
+        } else if (spins < 256) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    std::vector<T> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+#endif
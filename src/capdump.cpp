@@ -1,6 +1,9 @@
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <thread>
 #include "CapnpReader.h"
+#include "FileSummary.h"
 
 void printUsage(const char* progName) {
     std::cout << "Usage: " << progName << " <input.cap> [options]\n";
@@ -8,6 +11,16 @@ void printUsage(const char* progName) {
     std::cout << "Options:\n";
     std::cout << "  -v, --verbose    Show detailed information for all events\n";
     std::cout << "  -n NUM           Show only first NUM packets (default: all)\n";
+    std::cout << "  -s, --summary    Print totals, per-type counts and per board/channel\n";
+    std::cout << "                   events, time range and rate instead of packets;\n";
+    std::cout << "                   reads only list sizes and timestamps, on --threads\n";
+    std::cout << "  --tick-ns NS     Nanoseconds per timestamp tick for the summary\n";
+    std::cout << "                   rates (default: 1)\n";
+    std::cout << "  --build-index    Write <input>.capidx with each packet's offset,\n";
+    std::cout << "                   length, type, event count and time range; later\n";
+    std::cout << "                   runs read totals from it\n";
+    std::cout << "  --threads N      Threads for --summary and --build-index (default:\n";
+    std::cout << "                   all cores)\n";
     std::cout << "  -h, --help       Show this help message\n";
 }
 
@@ -20,6 +33,10 @@ int main(int argc, char** argv) {
     std::string inputFile;
     bool verbose = false;
     int maxPackets = -1;
+    bool buildIndex = false;
+    bool summary = false;
+    double tickNs = 1;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
 
     // Parse arguments
     for (int i = 1; i < argc; i++) {
@@ -31,6 +48,18 @@ int main(int argc, char** argv) {
             return 0;
         } else if (arg == "-n" && i + 1 < argc) {
             maxPackets = std::atoi(argv[++i]);
+        } else if (arg == "-s" || arg == "--summary") {
+            summary = true;
+        } else if (arg == "--tick-ns" && i + 1 < argc) {
+            tickNs = std::atof(argv[++i]);
+            if (tickNs <= 0) {
+                std::cerr << "Error: Invalid tick length " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--build-index") {
+            buildIndex = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
         } else if (inputFile.empty()) {
             inputFile = arg;
         }
@@ -42,6 +71,36 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    if (buildIndex) {
+        MessageIndex index;
+        if (!CapnpReader::BuildIndex(inputFile, index, threads)) {
+            std::cerr << "Error: Cannot index " << inputFile << "\n";
+            return 1;
+        }
+        if (!index.Save(inputFile)) {
+            std::cerr << "Error: Cannot write " << MessageIndex::SidecarPath(inputFile) << "\n";
+            return 1;
+        }
+        std::cout << "Indexed " << index.Size() << " packets, " << index.TotalEvents()
+                  << " events: " << MessageIndex::SidecarPath(inputFile) << "\n";
+        return 0;
+    }
+
+    if (summary) {
+        FileSummary fileSummary;
+        std::cout << "Summary of " << inputFile << " (" << threads << " threads)\n";
+        if (!fileSummary.Build(inputFile, threads)) {
+            std::cerr << "Error: Cannot read input file " << inputFile << "\n";
+            return 1;
+        }
+        fileSummary.Print(std::cout, tickNs);
+        if (!fileSummary.Complete()) {
+            std::cerr << "Warning: " << inputFile << " is truncated or has a broken message; "
+                      << "the summary is incomplete\n";
+        }
+        return fileSummary.Complete() ? 0 : 2;
+    }
+
     std::cout << "Dumping Cap'n Proto file: " << inputFile << "\n";
     if (verbose) {
         std::cout << "Mode: Verbose (showing all events)\n";
@@ -57,38 +116,20 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    // One pass: the dumped packets give the totals
     int packetCount = 0;
-    int totalEvents = 0;
-
+    uint64_t totalEvents = 0;
     while (reader.HasNext()) {
         if (maxPackets > 0 && packetCount >= maxPackets) {
             break;
         }
 
-        // Read packet to count events
-        auto events = reader.ReadNextPacket();
-        if (events.empty()) {
+        const size_t before = reader.NextPacket();
+        totalEvents += reader.DumpPacket(packetCount, verbose);
+        // DumpPacket() reports the end without consuming a packet
+        if (reader.NextPacket() == before) {
             break;
         }
-
-        totalEvents += events.size();
-        packetCount++;
-    }
-
-    // Reopen file to dump
-    reader.Close();
-    if (!reader.Open(inputFile)) {
-        std::cerr << "Error: Cannot reopen file\n";
-        return 1;
-    }
-
-    packetCount = 0;
-    while (reader.HasNext()) {
-        if (maxPackets > 0 && packetCount >= maxPackets) {
-            break;
-        }
-
-        reader.DumpPacket(packetCount, verbose);
         packetCount++;
     }
 
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include "EventGenerator.h"
+
+// Writes synthetic .cap files for testing and benchmarking cap2root without
+// beam data.
+
+void printUsage(const char* progName) {
+    std::cout << "Usage: " << progName << " [options] <output.cap>\n";
+    std::cout << "Generate a synthetic Cap'n Proto event file\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  -t, --type TYPE         plain, psd, wave, dualwave, full, rawtime,\n";
+    std::cout << "                          cross, psdwave or 0-7 (default: plain)\n";
+    std::cout << "  -e, --events N          Number of events (default: 1000000)\n";
+    std::cout << "  -p, --packet-size N     Events per packet (default: 1000)\n";
+    std::cout << "  -s, --samples N         Waveform length (default: 512)\n";
+    std::cout << "  --boards N              Number of boards (default: 4)\n";
+    std::cout << "  --channels N            Channels per board (default: 16)\n";
+    std::cout << "  --spacing TICKS         Mean timestamp step (default: 100)\n";
+    std::cout << "  --disorder FRACTION     Fraction of events moved back in time\n";
+    std::cout << "                          (default: 0)\n";
+    std::cout << "  --disorder-window TICKS Largest backward move (default: 10000)\n";
+    std::cout << "  --unpacked              Write the unpacked framing\n";
+    std::cout << "  --seed N                Random seed (default: 1)\n";
+    std::cout << "  -h, --help              Show this help message\n";
+}
+
+int main(int argc, char** argv) {
+    GeneratorConfig config;
+    std::string outputFile;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if ((arg == "-t" || arg == "--type") && hasValue) {
+            config.type = EventGenerator::ParseType(argv[++i]);
+            if (config.type < 0) {
+                std::cerr << "Error: Unknown event type " << argv[i] << "\n";
+                return 1;
+            }
+        } else if ((arg == "-e" || arg == "--events") && hasValue) {
+            config.events = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-p" || arg == "--packet-size") && hasValue) {
+            config.packetSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-s" || arg == "--samples") && hasValue) {
+            config.samples = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--boards" && hasValue) {
+            config.boards = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--channels" && hasValue) {
+            config.channels = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--spacing" && hasValue) {
+            config.spacing = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--disorder" && hasValue) {
+            config.disorder = std::atof(argv[++i]);
+        } else if (arg == "--disorder-window" && hasValue) {
+            config.disorderWindow = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--unpacked") {
+            config.packed = false;
+        } else if (arg == "--seed" && hasValue) {
+            config.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (outputFile.empty()) {
+            outputFile = arg;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (outputFile.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    EventGenerator generator(config);
+    std::cout << "Writing " << config.events << " " << EventGenerator::TypeName(config.type)
+              << " events in " << generator.NumPackets() << " "
+              << (config.packed ? "packed" : "unpacked") << " packets to "
+              << outputFile << "...\n";
+
+    if (!generator.Write(outputFile)) {
+        return 1;
+    }
+
+    std::cout << "Done.\n";
+    return 0;
+}
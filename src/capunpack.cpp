@@ -0,0 +1,65 @@
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <capnp/message.h>
+#include <capnp/serialize.h>
+#include <capnp/serialize-packed.h>
+#include <kj/io.h>
+#include "eventProto.capnp.h"
+
+// Rewrites a packed .cap file in the unpacked Cap'n Proto framing, which
+// CapnpReader memory-maps and reads in place.
+
+void printUsage(const char* progName) {
+    std::cout << "Usage: " << progName << " <input.cap> <output.cap>\n";
+    std::cout << "Rewrite a packed Cap'n Proto file in the unpacked framing\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    int inFd = open(argv[1], O_RDONLY);
+    if (inFd < 0) {
+        std::cerr << "Error: Cannot open input file " << argv[1] << "\n";
+        return 1;
+    }
+    int outFd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outFd < 0) {
+        std::cerr << "Error: Cannot create output file " << argv[2] << "\n";
+        close(inFd);
+        return 1;
+    }
+
+    int messageCount = 0;
+    int status = 0;
+
+    try {
+        kj::FdInputStream fdStream(inFd);
+        kj::BufferedInputStreamWrapper bufferedStream(fdStream);
+
+        while (bufferedStream.tryGetReadBuffer() != nullptr) {
+            capnp::PackedMessageReader message(bufferedStream, {100000000, 64});
+
+            // Every *Data struct shares one layout and capnp copies
+            // structs without consulting the schema, so PlainData copies
+            // any packet type faithfully
+            capnp::MallocMessageBuilder builder;
+            builder.setRoot(message.getRoot<PlainData>());
+            capnp::writeMessageToFd(outFd, builder);
+            messageCount++;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        status = 1;
+    }
+
+    close(inFd);
+    close(outFd);
+
+    std::cout << "Wrote " << messageCount << " unpacked messages to " << argv[2] << "\n";
+    return status;
+}
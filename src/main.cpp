@@ -2,96 +2,879 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <glob.h>
 #include "CapnpReader.h"
 #include "RootWriter.h"
+#include "EventWriter.h"
+#include "ExternalSorter.h"
+#include "MultiFileSorter.h"
+#include "RunMerger.h"
+#include "ParallelDecoder.h"
+#include "Pipeline.h"
+#include "ConversionStats.h"
+#include "BatchConverter.h"
+#include "FileFollower.h"
+#include "ReorderBuffer.h"
+#include "EventFilter.h"
 
 void printUsage(const char* progName) {
-    std::cout << "Usage: " << progName << " <input.cap> <output.root>\n";
+    std::cout << "Usage: " << progName << " [options] <input.cap>... <output.root>\n";
+    std::cout << "       " << progName << " [options] --batch <dir> [<output dir>]\n";
     std::cout << "Convert Cap'n Proto files to ROOT format\n";
-    std::cout << "Events are sorted by timestamp before writing.\n";
+    std::cout << "Events are sorted by timestamp before writing. Several inputs (or a\n";
+    std::cout << "quoted pattern such as 'run_*.cap') are merged into one time-ordered\n";
+    std::cout << "output.\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  --max-memory SIZE  Bound event memory (e.g. 512M, 4G); sorted chunks\n";
+    std::cout << "                     are spilled to disk and merged into the output.\n";
+    std::cout << "                     With several inputs this is the budget per file\n";
+    std::cout << "                     being read, so reading uses up to --threads times\n";
+    std::cout << "                     SIZE and the merge about SIZE (default: 512M)\n";
+    std::cout << "  --tmp-dir DIR      Directory for spilled chunks (default: system temp)\n";
+    std::cout << "  --sort MODE        In-memory sort: merge (default) k-way merges the\n";
+    std::cout << "                     per-(Mod,Ch) time-ordered runs, stable does a full\n";
+    std::cout << "                     std::stable_sort, radix does a radix sort on the\n";
+    std::cout << "                     timestamps on --threads threads; all give\n";
+    std::cout << "                     identical output\n";
+    std::cout << "  --threads N        Decode messages on N threads (default: 1)\n";
+    std::cout << "  --compression ALG  Output compression: lz4:4, zstd:5, zlib:1 (default),\n";
+    std::cout << "                     lzma:7 or none; the level may be omitted\n";
+    std::cout << "  --format FORMAT    Output as ttree (default) or rntuple\n";
+    std::cout << "  --write-threads N  Compress output baskets on N ROOT threads\n";
+    std::cout << "                     (implicit MT, default: 1)\n";
+    std::cout << "  --order MODE       time (default) sorts by timestamp; packet streams\n";
+    std::cout << "                     events in file order through a pipelined\n";
+    std::cout << "                     read/decode/write engine without sorting\n";
+    std::cout << "  --batch DIR        Convert every .cap file in DIR to <name>.root in one\n";
+    std::cout << "                     process; --threads files run concurrently within a\n";
+    std::cout << "                     --max-memory budget (default: half of RAM), and\n";
+    std::cout << "                     existing outputs are skipped\n";
+    std::cout << "  --follow           Convert a file while it is still being written:\n";
+    std::cout << "                     new messages are decoded as they appear, time-\n";
+    std::cout << "                     ordered within --reorder-window and flushed\n";
+    std::cout << "                     every --flush-interval; stops on Ctrl-C or after\n";
+    std::cout << "                     --idle-timeout seconds without new data\n";
+    std::cout << "  --reorder-window T Instead of a full sort, write each event once an\n";
+    std::cout << "                     event T ticks newer was read; memory holds one\n";
+    std::cout << "                     window. Events later than T are counted. Also\n";
+    std::cout << "                     the window of --follow (default: 10000000)\n";
+    std::cout << "  --flush-interval S Seconds between output flushes (default: 5)\n";
+    std::cout << "  --idle-timeout S   Stop following after S idle seconds (default: 0,\n";
+    std::cout << "                     never)\n";
+    std::cout << "  --time-range A:B   Convert only events with A <= TimeStamp < B (ticks;\n";
+    std::cout << "                     either bound may be omitted). With a .capidx\n";
+    std::cout << "                     index, packets outside the range are not read\n";
+    std::cout << "  --boards LIST      Convert only these boards, e.g. 0,2,4-7\n";
+    std::cout << "  --channels LIST    Convert only these channels, e.g. 0-3,8\n";
+    std::cout << "  --write-index      Save <input>.capidx, the packet index with per-\n";
+    std::cout << "                     packet type, event count and time range, next to\n";
+    std::cout << "                     each input while converting. Not with --follow,\n";
+    std::cout << "                     --batch, --order packet, or several inputs unless\n";
+    std::cout << "                     --reorder-window is given; skipped with a filter\n";
+    std::cout << "  --stats            Print wall/CPU time, events/s, bytes and peak RSS\n";
+    std::cout << "                     per stage, and packet/event counts per type;\n";
+    std::cout << "                     not with --batch\n";
+    std::cout << "  --stats-json FILE  Write the same statistics as JSON to FILE\n";
+    std::cout << "  -h, --help         Show this help message\n";
 }
 
-int main(int argc, char** argv) {
-    if (argc != 3) {
-        printUsage(argv[0]);
-        return 1;
+// Output file settings shared by all conversion paths
+struct OutputSettings {
+    std::string format = "ttree";
+    int compression = 101;
+    bool writeIndex = false;  // Write <input>.capidx next to each input
+    EventFilter filter;       // Events to convert
+};
+
+// Settings for --follow; the reorder window is also used on its own by
+// --reorder-window
+struct FollowSettings {
+    uint64_t reorderWindow = 10000000;
+    double flushInterval = 5;
+    double idleTimeout = 0;  // 0 follows until interrupted
+};
+
+// Parses "4G", "512M", "64K" or a plain byte count.  Returns 0 on error.
+size_t parseMemorySize(const std::string& text) {
+    size_t pos = 0;
+    double value = 0;
+    try {
+        value = std::stod(text, &pos);
+    } catch (const std::exception&) {
+        return 0;
+    }
+
+    std::string suffix = text.substr(pos);
+    double scale = 1;
+    if (suffix == "K" || suffix == "k") {
+        scale = 1024.0;
+    } else if (suffix == "M" || suffix == "m") {
+        scale = 1024.0 * 1024.0;
+    } else if (suffix == "G" || suffix == "g") {
+        scale = 1024.0 * 1024.0 * 1024.0;
+    } else if (!suffix.empty()) {
+        return 0;
+    }
+
+    return value > 0 ? static_cast<size_t>(value * scale) : 0;
+}
+
+// Expands quoted shell patterns such as "152Eu_walk_*.cap" in sorted order;
+// other arguments are taken as file names.  False if a pattern matches
+// nothing.
+bool expandInputs(const std::vector<std::string>& args, std::vector<std::string>& files) {
+    for (const std::string& arg : args) {
+        if (arg.find_first_of("*?[") == std::string::npos) {
+            files.push_back(arg);
+            continue;
+        }
+        glob_t matches;
+        if (glob(arg.c_str(), 0, nullptr, &matches) != 0) {
+            std::cerr << "Error: No input files match " << arg << "\n";
+            return false;
+        }
+        for (size_t i = 0; i < matches.gl_pathc; i++) {
+            files.push_back(matches.gl_pathv[i]);
+        }
+        globfree(&matches);
     }
+    return true;
+}
 
-    std::string inputFile = argv[1];
-    std::string outputFile = argv[2];
+// Hands every packet of the input to fn in file order and returns the packet
+// count, or -1 if the file cannot be opened.  With one thread CapnpReader
+// decodes sequentially into a reused batch; with more, or to write the
+// sidecar index, ParallelDecoder indexes the message boundaries and decodes
+// concurrently.
+int forEachPacket(const std::string& inputFile, unsigned threads, const OutputSettings& output,
+                  const std::function<void(EventBatch&)>& fn) {
+    int packetCount = 0;
 
-    std::cout << "Converting " << inputFile << " to " << outputFile << "...\n";
+    if (threads > 1 || output.writeIndex) {
+        ParallelDecoder decoder(threads);
+        if (!decoder.Open(inputFile)) {
+            return -1;
+        }
+        decoder.SetFilter(output.filter);
+        std::cout << (decoder.FromSidecar() ? "Loaded index of " : "Indexed ")
+                  << decoder.Index().Size() << " messages, decoding on "
+                  << threads << " threads\n";
+        decoder.Run([&](EventBatch& packet) {
+            if (packet.Empty()) {
+                return;
+            }
+            fn(packet);
+            packetCount++;
+        });
+        if (output.writeIndex) {
+            const std::string sidecar = MessageIndex::SidecarPath(inputFile);
+            if (decoder.FromSidecar()) {
+                std::cout << sidecar << " is already up to date\n";
+            } else if (output.filter.IsActive()) {
+                std::cerr << "Warning: Not writing " << sidecar
+                          << ": a filtered conversion does not describe every packet\n";
+            } else if (decoder.SaveIndex(inputFile)) {
+                std::cout << "Wrote " << sidecar << "\n";
+            } else {
+                std::cerr << "Warning: Not writing " << sidecar
+                          << ": the input is incomplete or the file cannot be written\n";
+            }
+        }
+        return packetCount;
+    }
 
     CapnpReader reader;
     if (!reader.Open(inputFile)) {
+        return -1;
+    }
+    reader.SetFilter(output.filter);
+
+    // ReadNextPacket() closes the reader at EOF or on a broken message;
+    // empty packets (e.g. unsupported types) are skipped
+    EventBatch packet;
+    while (reader.HasNext()) {
+        packet.Clear();
+        if (reader.ReadNextPacket(packet) == 0) {
+            continue;
+        }
+        fn(packet);
+        packetCount++;
+    }
+    reader.Close();
+
+    return packetCount;
+}
+
+// Bounded-memory path: sorted runs are spilled to disk and merged straight
+// into the writer.
+int convertExternal(const std::string& inputFile, const std::string& outputFile,
+                    const OutputSettings& output, unsigned threads, size_t maxMemory,
+                    const std::string& tmpDir, ConversionStats& stats) {
+    std::cout << "Reading events with a memory budget of "
+              << (maxMemory / (1024 * 1024)) << " MB...\n";
+
+    ExternalSorter sorter(maxMemory, tmpDir);
+    stats.Begin("read");
+
+    int packetCount = forEachPacket(inputFile, threads, output, [&](EventBatch& packet) {
+        sorter.Add(packet);
+        if (sorter.NumEvents() % 100000 < packet.Size()) {
+            std::cout << "Read " << sorter.NumEvents() << " events, "
+                      << sorter.NumChunks() << " chunks spilled\r" << std::flush;
+        }
+    });
+    if (packetCount < 0) {
         std::cerr << "Error: Cannot open input file " << inputFile << "\n";
         return 1;
     }
 
-    // Count total events first
-    std::cout << "Counting total events...\n";
-    size_t totalEvents = reader.CountTotalEvents();
-    std::cout << "Total events to read: " << totalEvents << "\n";
+    stats.End(sorter.NumEvents(), ConversionStats::FileBytes(inputFile));
 
-    // Reopen file for reading
-    if (!reader.Open(inputFile)) {
-        std::cerr << "Error: Cannot reopen input file " << inputFile << "\n";
+    std::cout << "\nRead complete. Total events: " << sorter.NumEvents()
+              << " (" << sorter.NumChunks() << " chunks spilled)\n";
+    std::cout << "Merging sorted chunks into ROOT file...\n";
+
+    stats.Begin("merge");
+    auto writer = EventWriter::Create(output.format, outputFile, output.compression);
+    size_t written = 0;
+    const size_t totalEvents = sorter.NumEvents();
+
+    sorter.Merge([&](const EventBatch& batch, size_t i) {
+        writer->Fill(batch.View(i));
+
+        if (++written % 100000 == 0) {
+            std::cout << "Written " << written << " / " << totalEvents
+                      << " events\r" << std::flush;
+        }
+    });
+
+    writer->Close();
+    stats.End(written, 0, ConversionStats::FileBytes(outputFile));
+
+    std::cout << "\nConversion complete!\n";
+    std::cout << "Total packets read: " << packetCount << "\n";
+    std::cout << "Total events written: " << written << "\n";
+
+    return 0;
+}
+
+// Streaming path for --order packet: reading, decoding and writing overlap
+// and events are written in file order, so nothing is held beyond the
+// pipeline's bounded queues.
+int convertPipelined(const std::vector<std::string>& inputFiles, const std::string& outputFile,
+                     const OutputSettings& output, unsigned threads,
+                     ConversionStats& stats) {
+    std::cout << "Streaming events in file order (" << threads << " decoder threads)...\n";
+
+    stats.Begin("stream");
+    auto writer = EventWriter::Create(output.format, outputFile, output.compression);
+    size_t written = 0;
+    long packetCount = 0;
+    uint64_t bytesIn = 0;
+
+    // Several inputs are streamed one after the other into the same output
+    Pipeline pipeline(threads);
+    pipeline.SetFilter(output.filter);
+    for (const std::string& inputFile : inputFiles) {
+        long packets = pipeline.Run(inputFile, [&](EventBatch& packet) {
+            writer->FillBatch(packet);
+            written += packet.Size();
+            if (written % 100000 < packet.Size()) {
+                std::cout << "Written " << written << " events\r" << std::flush;
+            }
+        });
+        if (packets < 0) {
+            std::cerr << "Error: Cannot open input file " << inputFile << "\n";
+            return 1;
+        }
+        packetCount += packets;
+        bytesIn += ConversionStats::FileBytes(inputFile);
+    }
+
+    writer->Close();
+    stats.End(written, bytesIn, ConversionStats::FileBytes(outputFile));
+
+    std::cout << "\nConversion complete!\n";
+    std::cout << "Total packets read: " << packetCount << "\n";
+    std::cout << "Total events written: " << written << "\n";
+
+    return 0;
+}
+
+// Several inputs: every file is sorted on its own with a bounded budget and
+// the per-file streams are merged into one time-ordered output.
+int convertMultiFile(const std::vector<std::string>& inputFiles, const std::string& outputFile,
+                     const OutputSettings& output, unsigned threads, size_t memoryPerFile,
+                     const std::string& tmpDir, ConversionStats& stats) {
+    std::cout << "Reading " << inputFiles.size() << " files on "
+              << std::min<size_t>(threads, inputFiles.size()) << " threads with "
+              << (memoryPerFile / (1024 * 1024)) << " MB per file...\n";
+
+    MultiFileSorter sorter(inputFiles, memoryPerFile, tmpDir, threads);
+    sorter.SetFilter(output.filter);
+    stats.Begin("read");
+
+    size_t filesRead = 0;
+    bool ok = sorter.Read([&](const std::string& file, size_t events) {
+        std::cout << "[" << ++filesRead << "/" << inputFiles.size() << "] " << file
+                  << ": " << events << " events\n";
+    });
+    if (!ok) {
+        std::cerr << "Error: Cannot open input file " << sorter.FailedFile() << "\n";
         return 1;
     }
 
-    // Read all events into memory with exact capacity
-    std::cout << "Reading events from Cap'n Proto file...\n";
-    std::vector<std::unique_ptr<TreeData>> allEvents;
-    allEvents.reserve(totalEvents);
-    int packetCount = 0;
+    uint64_t bytesIn = 0;
+    for (const std::string& inputFile : inputFiles) {
+        bytesIn += ConversionStats::FileBytes(inputFile);
+    }
+    stats.End(sorter.NumEvents(), bytesIn);
 
-    while (reader.HasNext()) {
-        auto events = reader.ReadNextPacket();
-        if (events.empty()) {
+    std::cout << "Read complete. Total events: " << sorter.NumEvents()
+              << " (" << sorter.NumChunks() << " chunks spilled)\n";
+    std::cout << "Merging " << inputFiles.size() << " files into ROOT file...\n";
+
+    stats.Begin("merge");
+    auto writer = EventWriter::Create(output.format, outputFile, output.compression);
+    size_t written = 0;
+    const size_t totalEvents = sorter.NumEvents();
+
+    sorter.Merge([&](const EventBatch& batch, size_t i) {
+        writer->Fill(batch.View(i));
+
+        if (++written % 100000 == 0) {
+            std::cout << "Written " << written << " / " << totalEvents
+                      << " events\r" << std::flush;
+        }
+    });
+
+    writer->Close();
+    stats.End(written, 0, ConversionStats::FileBytes(outputFile));
+
+    std::cout << "\nConversion complete!\n";
+    std::cout << "Total packets read: " << sorter.NumPackets() << "\n";
+    std::cout << "Total events written: " << written << "\n";
+
+    return 0;
+}
+
+// Directory mode: one process converts every file, scheduled by size
+// within the memory budget, and existing outputs are skipped.
+int convertBatch(const std::string& inputDir, const std::string& outputDir,
+                 const OutputSettings& output, unsigned threads, size_t maxMemory,
+                 const std::string& tmpDir) {
+    BatchSettings settings;
+    settings.format = output.format;
+    settings.compression = output.compression;
+    settings.threads = threads;
+    settings.memoryBudget = maxMemory;
+    settings.tmpDir = tmpDir;
+    settings.filter = output.filter;
+
+    BatchConverter converter(settings);
+    if (!converter.Plan(inputDir, outputDir)) {
+        std::cerr << "Error: No .cap files found in " << inputDir << "\n";
+        return 1;
+    }
+    std::cout << "Converting " << converter.Jobs().size() << " files on up to "
+              << threads << " threads (" << converter.NumSkipped() << " skipped)...\n";
+
+    size_t failed = converter.Run();
+
+    std::cout << "\nBatch complete!\n";
+    std::cout << "  Converted: " << converter.NumConverted() << "\n";
+    std::cout << "  Skipped:   " << converter.NumSkipped() << "\n";
+    std::cout << "  Failed:    " << failed << "\n";
+
+    return failed > 0 ? 1 : 0;
+}
+
+// Windowed path for --reorder-window: the inputs are read in order and
+// every event is written as soon as the window has passed it, so memory
+// holds one window of events instead of the whole run.
+int convertWindowed(const std::vector<std::string>& inputFiles, const std::string& outputFile,
+                    const OutputSettings& output, unsigned threads, uint64_t window,
+                    ConversionStats& stats) {
+    std::cout << "Reordering events within a window of " << window << " ticks...\n";
+
+    stats.Begin("reorder");
+    auto writer = EventWriter::Create(output.format, outputFile, output.compression);
+    ReorderBuffer reorder(window);
+    size_t written = 0;
+    size_t maxPending = 0;
+    auto sink = [&](const EventBatch& batch, size_t i) {
+        writer->Fill(batch.View(i));
+        if (++written % 100000 == 0) {
+            std::cout << "Written " << written << " events\r" << std::flush;
+        }
+    };
+
+    long packetCount = 0;
+    uint64_t bytesIn = 0;
+    for (const std::string& inputFile : inputFiles) {
+        int packets = forEachPacket(inputFile, threads, output, [&](EventBatch& packet) {
+            reorder.Add(packet);
+            maxPending = std::max(maxPending, reorder.Pending());
+            reorder.Emit(sink);
+        });
+        if (packets < 0) {
+            std::cerr << "Error: Cannot open input file " << inputFile << "\n";
+            return 1;
+        }
+        packetCount += packets;
+        bytesIn += ConversionStats::FileBytes(inputFile);
+    }
+    reorder.Flush(sink);
+
+    writer->Close();
+    stats.End(written, bytesIn, ConversionStats::FileBytes(outputFile));
+    stats.SetCounter("window_violations", reorder.NumViolations());
+    stats.SetCounter("max_pending_events", maxPending);
+
+    std::cout << "\nConversion complete!\n";
+    std::cout << "Total packets read: " << packetCount << "\n";
+    std::cout << "Total events written: " << written << "\n";
+    std::cout << "Largest reorder buffer: " << maxPending << " events\n";
+    std::cout << "Window violations: " << reorder.NumViolations() << "\n";
+    if (reorder.NumViolations() > 0) {
+        std::cout << "Warning: " << reorder.NumViolations() << " events arrived more than "
+                  << window << " ticks late and may be out of order; use a larger window "
+                  << "or the full sort\n";
+    }
+
+    return 0;
+}
+
+volatile std::sig_atomic_t stopFollowing = 0;
+
+void requestStop(int) {
+    stopFollowing = 1;
+}
+
+// Follow path: the file is tailed while the DAQ writes it.  Complete
+// messages are decoded as they land, events are written once the reorder
+// window has passed them, and the output is flushed periodically so it can
+// be opened for online monitoring.
+int convertFollow(const std::string& inputFile, const std::string& outputFile,
+                  const OutputSettings& output, const FollowSettings& follow,
+                  ConversionStats& stats) {
+    using Clock = std::chrono::steady_clock;
+
+    FileFollower follower;
+    follower.SetFilter(output.filter);
+    if (!follower.Open(inputFile)) {
+        std::cerr << "Error: Cannot open input file " << inputFile << "\n";
+        return 1;
+    }
+    std::cout << "Following " << inputFile << " ("
+              << (follower.UsesInotify() ? "inotify" : "polling") << "), reorder window "
+              << follow.reorderWindow << " ticks, flushing every " << follow.flushInterval
+              << " s. Press Ctrl-C to finish.\n";
+
+    stopFollowing = 0;
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    stats.Begin("follow");
+    auto writer = EventWriter::Create(output.format, outputFile, output.compression);
+    ReorderBuffer reorder(follow.reorderWindow);
+    size_t written = 0;
+    auto sink = [&](const EventBatch& batch, size_t i) {
+        writer->Fill(batch.View(i));
+        written++;
+    };
+
+    EventBatch packet;
+    Clock::time_point lastFlush = Clock::now();
+    Clock::time_point lastData = lastFlush;
+    size_t flushed = 0;
+    while (!stopFollowing) {
+        uint64_t before = follower.BytesRead();
+        packet.Clear();
+        follower.Poll(packet);
+        reorder.Add(packet);
+        reorder.Emit(sink);
+        if (follower.Malformed()) {
             break;
         }
 
-        allEvents.insert(allEvents.end(),
-                        std::make_move_iterator(events.begin()),
-                        std::make_move_iterator(events.end()));
-        packetCount++;
+        Clock::time_point now = Clock::now();
+        bool idle = follower.BytesRead() == before;
+        if (!idle) {
+            lastData = now;
+        }
+        if (written > flushed
+            && std::chrono::duration<double>(now - lastFlush).count() >= follow.flushInterval) {
+            writer->Flush();
+            flushed = written;
+            lastFlush = now;
+            std::cout << "Written " << written << " events, " << reorder.Pending()
+                      << " pending\r" << std::flush;
+        }
+        if (idle) {
+            if (follow.idleTimeout > 0
+                && std::chrono::duration<double>(now - lastData).count() >= follow.idleTimeout) {
+                break;
+            }
+            // Short waits keep flushes and Ctrl-C responsive
+            follower.Wait(250);
+        }
+    }
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+
+    reorder.Flush(sink);
+    writer->Close();
+    stats.End(written, follower.BytesRead(), ConversionStats::FileBytes(outputFile));
+    stats.SetCounter("window_violations", reorder.NumViolations());
 
-        if (packetCount % 100 == 0) {
-            std::cout << "Read " << packetCount << " packets, "
-                      << allEvents.size() << " events\r" << std::flush;
+    std::cout << "\nConversion complete!\n";
+    std::cout << "Total packets read: " << follower.NumPackets() << "\n";
+    std::cout << "Total events written: " << written << "\n";
+    if (follower.Malformed()) {
+        std::cerr << "Error: " << inputFile << " has a malformed message at byte "
+                  << follower.BytesRead() - follower.PendingBytes() << "\n";
+    } else if (follower.PendingBytes() > 0) {
+        std::cout << "Incomplete message at end of file: " << follower.PendingBytes()
+                  << " bytes not converted\n";
+    }
+    if (reorder.NumViolations() > 0) {
+        std::cout << reorder.NumViolations() << " events arrived more than the reorder window "
+                  << "late and may be out of order\n";
+    }
+
+    return follower.Malformed() ? 1 : 0;
+}
+
+// In-memory path: all events go into one columnar batch, which is sorted
+// through an index permutation and written in that order.
+int convertInMemory(const std::string& inputFile, const std::string& outputFile,
+                    const OutputSettings& output, unsigned threads,
+                    const std::string& sortMode,
+                    ConversionStats& stats) {
+    // Single pass: every message is unpacked exactly once and the columns
+    // grow geometrically, so no pre-scan for the event count is needed.
+    std::cout << "Reading events from Cap'n Proto file...\n";
+    EventBatch allEvents;
+    RunMerger merger;
+    stats.Begin("read");
+
+    int packetCount = forEachPacket(inputFile, threads, output, [&](EventBatch& packet) {
+        size_t first = allEvents.Size();
+        allEvents.Append(packet);
+        if (sortMode == "merge") {
+            merger.Observe(allEvents, first);
         }
+        if (allEvents.Size() % 100000 < packet.Size()) {
+            std::cout << "Read " << allEvents.Size() << " events\r" << std::flush;
+        }
+    });
+    if (packetCount < 0) {
+        std::cerr << "Error: Cannot open input file " << inputFile << "\n";
+        return 1;
     }
 
-    reader.Close();
+    stats.End(allEvents.Size(), ConversionStats::FileBytes(inputFile));
 
-    std::cout << "\nRead complete. Total events: " << allEvents.size() << "\n";
-    std::cout << "Sorting events by timestamp...\n";
+    std::cout << "\nRead complete. Total events: " << allEvents.Size() << "\n";
 
-    // Sort by timestamp
-    std::sort(allEvents.begin(), allEvents.end(),
-              [](const std::unique_ptr<TreeData>& a, const std::unique_ptr<TreeData>& b) {
-                  return a->TimeStamp < b->TimeStamp;
-              });
+    // All orders break timestamp ties by file order, so they are identical
+    std::vector<size_t> order;
+    stats.Begin("sort");
+    if (sortMode == "merge") {
+        std::cout << "Merging " << merger.NumRuns() << " time-ordered runs from "
+                  << merger.NumStreams() << " (Mod,Ch) streams...\n";
+        order = merger.Merge(allEvents);
+        if (merger.NumSortedStreams() > 0) {
+            std::cout << merger.NumSortedStreams()
+                      << " out-of-order streams were sorted instead of merged\n";
+        }
+    } else if (sortMode == "radix") {
+        std::cout << "Radix sorting events by timestamp on " << threads << " threads...\n";
+        order = allEvents.RadixTimeOrder(threads);
+    } else {
+        std::cout << "Sorting events by timestamp...\n";
+        order = allEvents.StableTimeOrder();
+    }
+    stats.End(order.size());
     std::cout << "Sorting complete.\n";
     std::cout << "Writing to ROOT file...\n";
 
     // Write sorted events to ROOT file
-    RootWriter writer(outputFile);
+    stats.Begin("write");
+    auto writer = EventWriter::Create(output.format, outputFile, output.compression);
 
-    for (size_t i = 0; i < allEvents.size(); i++) {
-        writer.Fill(*allEvents[i]);
+    const size_t progressStep = 100000;
+    for (size_t begin = 0; begin < order.size(); begin += progressStep) {
+        size_t end = std::min(begin + progressStep, order.size());
+        writer->FillBatch(allEvents, begin, end, &order);
 
-        if ((i + 1) % 100000 == 0) {
-            std::cout << "Written " << (i + 1) << " / " << allEvents.size()
+        if (end % progressStep == 0) {
+            std::cout << "Written " << end << " / " << order.size()
                       << " events\r" << std::flush;
         }
     }
 
-    writer.Close();
+    writer->Close();
+    stats.End(order.size(), 0, ConversionStats::FileBytes(outputFile));
 
     std::cout << "\nConversion complete!\n";
     std::cout << "Total packets read: " << packetCount << "\n";
-    std::cout << "Total events written: " << allEvents.size() << "\n";
+    std::cout << "Total events written: " << order.size() << "\n";
 
     return 0;
 }
+
+int main(int argc, char** argv) {
+    std::vector<std::string> positional;
+    std::string tmpDir;
+    std::string sortMode = "merge";
+    std::string order = "time";
+    size_t maxMemory = 0;
+    unsigned threads = 1;
+    unsigned writeThreads = 1;
+    OutputSettings output;
+    bool printStats = false;
+    std::string statsJson;
+    std::string batchDir;
+    bool followMode = false;
+    bool windowed = false;
+    FollowSettings follow;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "--max-memory" && i + 1 < argc) {
+            maxMemory = parseMemorySize(argv[++i]);
+            if (maxMemory == 0) {
+                std::cerr << "Error: Invalid memory size " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--tmp-dir" && i + 1 < argc) {
+            tmpDir = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            int n = std::atoi(argv[++i]);
+            if (n < 1) {
+                std::cerr << "Error: Invalid thread count " << argv[i] << "\n";
+                return 1;
+            }
+            threads = n;
+        } else if (arg == "--compression" && i + 1 < argc) {
+            if (!RootWriter::ParseCompression(argv[++i], output.compression)) {
+                std::cerr << "Error: Unknown compression " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--write-threads" && i + 1 < argc) {
+            int n = std::atoi(argv[++i]);
+            if (n < 1) {
+                std::cerr << "Error: Invalid write thread count " << argv[i] << "\n";
+                return 1;
+            }
+            writeThreads = n;
+        } else if (arg == "--order" && i + 1 < argc) {
+            order = argv[++i];
+            if (order != "time" && order != "packet") {
+                std::cerr << "Error: Unknown output order " << order << "\n";
+                return 1;
+            }
+        } else if (arg == "--format" && i + 1 < argc) {
+            output.format = argv[++i];
+            if (output.format != "ttree" && output.format != "rntuple") {
+                std::cerr << "Error: Unknown output format " << output.format << "\n";
+                return 1;
+            }
+            if (!EventWriter::HasFormat(output.format)) {
+                std::cerr << "Error: This build has no " << output.format
+                          << " support (needs ROOT >= 6.34 with RNTuple)\n";
+                return 1;
+            }
+        } else if (arg == "--follow") {
+            followMode = true;
+        } else if (arg == "--reorder-window" && i + 1 < argc) {
+            const char* text = argv[++i];
+            char* end = nullptr;
+            errno = 0;
+            follow.reorderWindow = std::strtoull(text, &end, 10);
+            if (!std::isdigit(static_cast<unsigned char>(text[0])) || *end != '\0' || errno == ERANGE) {
+                std::cerr << "Error: Invalid reorder window " << text << "\n";
+                return 1;
+            }
+            windowed = true;
+        } else if (arg == "--flush-interval" && i + 1 < argc) {
+            follow.flushInterval = std::atof(argv[++i]);
+            if (follow.flushInterval <= 0) {
+                std::cerr << "Error: Invalid flush interval " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--idle-timeout" && i + 1 < argc) {
+            follow.idleTimeout = std::atof(argv[++i]);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchDir = argv[++i];
+        } else if (arg == "--time-range" && i + 1 < argc) {
+            if (!output.filter.ParseTimeRange(argv[++i])) {
+                std::cerr << "Error: Invalid time range " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--boards" && i + 1 < argc) {
+            if (!output.filter.ParseBoards(argv[++i])) {
+                std::cerr << "Error: Invalid board list " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--channels" && i + 1 < argc) {
+            if (!output.filter.ParseChannels(argv[++i])) {
+                std::cerr << "Error: Invalid channel list " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--write-index") {
+            output.writeIndex = true;
+        } else if (arg == "--stats") {
+            printStats = true;
+        } else if (arg == "--stats-json" && i + 1 < argc) {
+            statsJson = argv[++i];
+        } else if (arg == "--sort" && i + 1 < argc) {
+            sortMode = argv[++i];
+            if (sortMode != "merge" && sortMode != "stable" && sortMode != "radix") {
+                std::cerr << "Error: Unknown sort mode " << sortMode << "\n";
+                return 1;
+            }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (output.filter.IsActive()) {
+        std::cout << "Converting only " << output.filter.Describe() << "\n";
+    }
+
+    if (!batchDir.empty()) {
+        if (positional.size() > 1) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (output.writeIndex) {
+            std::cerr << "Error: --write-index does not work with --batch\n";
+            return 1;
+        }
+        // Jobs run concurrently, so per-stage times and peak RSS would mix
+        if (printStats || !statsJson.empty()) {
+            std::cerr << "Error: --stats and --stats-json do not work with --batch\n";
+            return 1;
+        }
+        if (writeThreads > 1) {
+            RootWriter::EnableParallelCompression(writeThreads);
+        }
+        try {
+            return convertBatch(batchDir, positional.empty() ? "" : positional[0], output,
+                                threads, maxMemory, tmpDir);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (positional.size() < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // The last argument is the output, everything before it is input
+    const std::string outputFile = positional.back();
+    positional.pop_back();
+    std::vector<std::string> inputFiles;
+    if (!expandInputs(positional, inputFiles)) {
+        return 1;
+    }
+    const std::string& inputFile = inputFiles.front();
+
+    std::string inputList = inputFile;
+    for (size_t i = 1; i < inputFiles.size(); i++) {
+        inputList += " " + inputFiles[i];
+    }
+    if (inputFiles.size() == 1) {
+        std::cout << "Converting " << inputFile << " to " << outputFile << "...\n";
+    } else {
+        std::cout << "Converting " << inputFiles.size() << " files to " << outputFile << "...\n";
+    }
+
+    if (writeThreads > 1) {
+        std::cout << "Compressing output on " << writeThreads << " threads\n";
+        RootWriter::EnableParallelCompression(writeThreads);
+    }
+
+    if (followMode && inputFiles.size() > 1) {
+        std::cerr << "Error: --follow takes a single input file\n";
+        return 1;
+    }
+    // Only the paths that decode through forEachPacket() describe packets
+    if (output.writeIndex
+        && (followMode || order == "packet" || (inputFiles.size() > 1 && !windowed))) {
+        std::cerr << "Error: --write-index does not work with "
+                  << (followMode ? "--follow" : order == "packet" ? "--order packet"
+                                                                  : "several inputs sorted by time")
+                  << "\n";
+        return 1;
+    }
+    if (followMode && output.format == "rntuple") {
+        // Flush() only commits a cluster; the footer that makes it readable
+        // is written by Close()
+        std::cerr << "Warning: RNTuple output becomes readable only when following stops;"
+                  << " use --format ttree to watch it live\n";
+    }
+
+    ConversionStats stats;
+    int status;
+    if (followMode) {
+        try {
+            status = convertFollow(inputFile, outputFile, output, follow, stats);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            status = 1;
+        }
+    } else if (order == "packet") {
+        status = convertPipelined(inputFiles, outputFile, output, threads, stats);
+    } else if (windowed) {
+        status = convertWindowed(inputFiles, outputFile, output, threads,
+                                 follow.reorderWindow, stats);
+    } else if (inputFiles.size() > 1) {
+        try {
+            status = convertMultiFile(inputFiles, outputFile, output, threads,
+                                      maxMemory > 0 ? maxMemory : parseMemorySize("512M"),
+                                      tmpDir, stats);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            status = 1;
+        }
+    } else if (maxMemory > 0) {
+        try {
+            status = convertExternal(inputFile, outputFile, output, threads, maxMemory,
+                                     tmpDir, stats);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            status = 1;
+        }
+    } else {
+        status = convertInMemory(inputFile, outputFile, output, threads, sortMode, stats);
+    }
+
+    if (printStats) {
+        stats.Print(std::cout);
+    }
+    if (!statsJson.empty() && !stats.WriteJson(statsJson, inputList, outputFile)) {
+        std::cerr << "Error: Cannot write statistics to " << statsJson << "\n";
+        return 1;
+    }
+
+    return status;
+}
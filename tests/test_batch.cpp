@@ -0,0 +1,78 @@
+#include "../src/EventBatch.h"
+#include <iostream>
+#include <stdexcept>
+
+void test_batch() {
+    std::cout << "Testing EventBatch...\n";
+
+    EventBatch batch;
+    batch.Add(1, 2, 300, 300.0, 100, 0);
+    if (batch.Size() != 1 || batch.HasTraces() || batch.Trace1(0) != nullptr) {
+        throw std::runtime_error("EventBatch plain event");
+    }
+    std::cout << "  ✓ EventBatch plain events carry no trace columns\n";
+
+    // A waveform event after a plain one enables the trace columns
+    batch.Add(3, 4, 200, 200.0, 50, 7);
+    uint16_t* trace = batch.AddTraces(3, 2);
+    for (int s = 0; s < 5; s++) {
+        trace[s] = 10 + s;
+    }
+    batch.Add(5, 6, 100, 100.0, 25, 0);
+
+    if (!batch.HasTraces() || batch.RecordLength[1] != 3 || batch.Trace2Size(1) != 2
+        || batch.Trace1(1)[2] != 12 || batch.Trace2(1)[0] != 13
+        || batch.RecordLength[0] != 0 || batch.Trace2Size(2) != 0) {
+        throw std::runtime_error("EventBatch trace pool layout");
+    }
+    std::cout << "  ✓ EventBatch trace pool layout\n";
+
+    TreeData data;
+    batch.Get(1, data);
+    if (data.Mod != 3 || data.TimeStamp != 200 || data.ChargeShort != 7
+        || data.Trace1 != std::vector<uint16_t>({10, 11, 12})
+        || data.Trace2 != std::vector<uint16_t>({13, 14})) {
+        throw std::runtime_error("EventBatch::Get");
+    }
+
+    EventBatch copy;
+    copy.Add(data);
+    batch.Get(0, data);
+    copy.Add(data);
+    if (copy.Size() != 2 || copy.Trace1(0)[0] != 10 || copy.Trace2Size(0) != 2
+        || copy.RecordLength[1] != 0) {
+        throw std::runtime_error("EventBatch::Add(TreeData)");
+    }
+    std::cout << "  ✓ EventBatch TreeData round trip\n";
+
+    // Bulk append rebases trace offsets and pads plain batches
+    EventBatch joined;
+    joined.Add(9, 9, 50, 50.0, 1, 0);
+    joined.Append(batch);
+    joined.Append(copy);
+    if (joined.Size() != 6 || !joined.HasTraces() || joined.Trace1(2)[1] != 11
+        || joined.Trace2(2)[1] != 14 || joined.Trace1(4)[0] != 10
+        || joined.RecordLength[0] != 0 || joined.Trace2Size(5) != 0) {
+        throw std::runtime_error("EventBatch::Append");
+    }
+    std::cout << "  ✓ EventBatch bulk append\n";
+
+    if (batch.StableTimeOrder() != std::vector<size_t>({2, 1, 0})) {
+        throw std::runtime_error("EventBatch::StableTimeOrder");
+    }
+    std::cout << "  ✓ EventBatch index sort\n";
+
+    // Radix order equals the stable sort, with ties, keys differing only in
+    // high bits and more threads than a slice needs
+    EventBatch keys;
+    for (uint64_t i = 0; i < 200000; i++) {
+        uint64_t ts = (i * 2654435761u) % 1000;
+        keys.Add(0, 0, (i % 3 == 0 ? ts << 50 : ts) + (1ull << 40), 0.0, 0, 0);
+    }
+    std::vector<size_t> expected = keys.StableTimeOrder();
+    if (keys.RadixTimeOrder(1) != expected || keys.RadixTimeOrder(4) != expected
+        || EventBatch().RadixTimeOrder(4).size() != 0) {
+        throw std::runtime_error("EventBatch::RadixTimeOrder");
+    }
+    std::cout << "  ✓ EventBatch radix sort\n";
+}
@@ -0,0 +1,159 @@
+#include "../src/MessageIndex.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Unpacked framing of a single-segment message with the given body words
+std::vector<uint8_t> MakeMessage(const std::vector<uint64_t>& body) {
+    std::vector<uint8_t> bytes(8 + body.size() * 8);
+    uint32_t segmentCountMinusOne = 0;
+    uint32_t words = body.size();
+    std::memcpy(bytes.data(), &segmentCountMinusOne, 4);
+    std::memcpy(bytes.data() + 4, &words, 4);
+    std::memcpy(bytes.data() + 8, body.data(), body.size() * 8);
+    return bytes;
+}
+
+// Reference implementation of the Cap'n Proto packing
+std::vector<uint8_t> Pack(const std::vector<uint8_t>& in) {
+    std::vector<uint8_t> out;
+    size_t words = in.size() / 8;
+    for (size_t w = 0; w < words; w++) {
+        const uint8_t* word = in.data() + w * 8;
+        uint8_t tag = 0;
+        for (int b = 0; b < 8; b++) {
+            if (word[b]) {
+                tag |= 1u << b;
+            }
+        }
+        out.push_back(tag);
+        for (int b = 0; b < 8; b++) {
+            if (word[b]) {
+                out.push_back(word[b]);
+            }
+        }
+        if (tag == 0x00 || tag == 0xFF) {
+            size_t run = 0;
+            while (w + 1 + run < words && run < 255) {
+                const uint8_t* next = in.data() + (w + 1 + run) * 8;
+                bool allZero = true, noZero = true;
+                for (int b = 0; b < 8; b++) {
+                    allZero = allZero && next[b] == 0;
+                    noZero = noZero && next[b] != 0;
+                }
+                if ((tag == 0x00 && !allZero) || (tag == 0xFF && !noZero)) {
+                    break;
+                }
+                run++;
+            }
+            out.push_back(run);
+            if (tag == 0xFF) {
+                out.insert(out.end(), in.begin() + (w + 1) * 8, in.begin() + (w + 1 + run) * 8);
+            }
+            w += run;
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+void test_index() {
+    std::cout << "Testing MessageIndex...\n";
+
+    // Zero runs, raw runs and sparse words, in two messages of different size
+    std::vector<uint64_t> body1 = {0x0000000100000000ull, 0, 0, 0, 0x1122334455667788ull,
+                                   0x0102030405060708ull, 0x00ff000000000012ull};
+    std::vector<uint64_t> body2(300, 0);
+    body2[0] = 0x42;
+    body2[299] = 0x8000000000000000ull;
+
+    std::vector<uint8_t> unpacked = MakeMessage(body1);
+    std::vector<uint8_t> second = MakeMessage(body2);
+    size_t firstLength = unpacked.size();
+    unpacked.insert(unpacked.end(), second.begin(), second.end());
+
+    MessageIndex index;
+    if (!index.Build(unpacked.data(), unpacked.size(), false) || index.Size() != 2
+        || index[1].offset != firstLength || index[1].length != second.size()) {
+        throw std::runtime_error("MessageIndex unpacked boundaries");
+    }
+    std::cout << "  ✓ MessageIndex unpacked boundaries\n";
+
+    std::vector<uint8_t> packed = Pack(MakeMessage(body1));
+    size_t packedFirst = packed.size();
+    std::vector<uint8_t> packedSecond = Pack(second);
+    packed.insert(packed.end(), packedSecond.begin(), packedSecond.end());
+
+    if (!index.Build(packed.data(), packed.size(), true) || index.Size() != 2
+        || index[0].length != packedFirst || index[1].offset != packedFirst
+        || index[1].length != packedSecond.size()) {
+        throw std::runtime_error("MessageIndex packed boundaries");
+    }
+    std::cout << "  ✓ MessageIndex packed boundaries\n";
+
+    if (MessageIndex::PackedMessageLength(packed.data(), packedFirst - 1) != 0
+        || index.Build(packed.data(), packed.size() - 1, true)) {
+        throw std::runtime_error("MessageIndex accepted a truncated message");
+    }
+    std::cout << "  ✓ MessageIndex rejects truncated messages\n";
+
+    // Test: A truncated message needs more bytes, a corrupt segment table
+    // never completes
+    bool malformed = true;
+    if (MessageIndex::PackedMessageLength(packed.data(), packedFirst - 1, &malformed) != 0 || malformed
+        || MessageIndex::UnpackedMessageLength(unpacked.data(), 12, &malformed) != 0 || malformed) {
+        throw std::runtime_error("MessageIndex flagged a truncated message as malformed");
+    }
+    std::vector<uint8_t> corrupt = unpacked;
+    uint32_t segments = 100000;
+    std::memcpy(corrupt.data(), &segments, 4);
+    std::vector<uint8_t> packedCorrupt = Pack(corrupt);
+    if (MessageIndex::UnpackedMessageLength(corrupt.data(), corrupt.size(), &malformed) != 0 || !malformed
+        || MessageIndex::PackedMessageLength(packedCorrupt.data(), packedCorrupt.size(), &malformed) != 0
+        || !malformed) {
+        throw std::runtime_error("MessageIndex missed a corrupt segment table");
+    }
+    std::cout << "  ✓ MessageIndex tells malformed from incomplete messages\n";
+
+    // Test: The sidecar keeps the summaries and goes stale with its .cap file
+    const std::string capFile = "test_index.cap";
+    FILE* fp = fopen(capFile.c_str(), "wb");
+    fwrite(packed.data(), 1, packed.size(), fp);
+    fclose(fp);
+    index.Build(packed.data(), packed.size(), true);
+    index.Describe(0, 2, 10, 100, 200);
+    index.Describe(1, 3, 5, 150, 400);
+    MessageIndex loaded;
+    if (MessageIndex::SidecarPath(capFile) != "test_index.capidx" || !index.Save(capFile)
+        || !loaded.Load(capFile) || loaded.Size() != 2 || !loaded.IsPacked()
+        || loaded.TotalEvents() != 15 || loaded[1].type != 3 || loaded[1].maxTimeStamp != 400
+        || loaded[1].offset != packedFirst) {
+        throw std::runtime_error("MessageIndex sidecar roundtrip");
+    }
+    fp = fopen(capFile.c_str(), "ab");
+    fwrite(packed.data(), 1, 8, fp);
+    fclose(fp);
+    if (loaded.Load(capFile)) {
+        throw std::runtime_error("MessageIndex loaded a stale sidecar");
+    }
+    MessageIndex prefix;
+    prefix.Build(packed.data(), packedFirst, true);
+    if (!prefix.Save(capFile) || loaded.Load(capFile)) {
+        throw std::runtime_error("MessageIndex loaded a sidecar covering part of the file");
+    }
+    std::remove(capFile.c_str());
+    std::remove(MessageIndex::SidecarPath(capFile).c_str());
+    std::cout << "  ✓ MessageIndex sidecar save/load\n";
+
+    // Test: Partitions cover every message once, split by bytes
+    std::vector<size_t> bounds = index.Partition(2);
+    if (bounds != std::vector<size_t>({0, 1, 2}) || index.Partition(8).back() != 2
+        || index.Partition(1) != std::vector<size_t>({0, 2})) {
+        throw std::runtime_error("MessageIndex partition");
+    }
+    std::cout << "  ✓ MessageIndex partitions\n";
+}
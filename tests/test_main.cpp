@@ -6,10 +6,18 @@ int main(int argc, char** argv) {
     // Simple test runner - calls will be added by individual test files
     extern void test_reader();
     extern void test_writer();
+    extern void test_batch();
+    extern void test_sorter();
+    extern void test_index();
+    extern void test_queue();
 
     try {
         test_reader();
         test_writer();
+        test_batch();
+        test_sorter();
+        test_index();
+        test_queue();
         std::cout << "All tests passed!\n";
         return 0;
     } catch (const std::exception& e) {
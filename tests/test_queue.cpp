@@ -0,0 +1,41 @@
+#include "../src/SpscQueue.h"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+void test_queue() {
+    std::cout << "Testing SpscQueue...\n";
+
+    std::atomic<bool> abort{false};
+    SpscQueue<std::unique_ptr<int>> queue(4);
+
+    // A tiny queue forces the producer to wait on the consumer
+    const int count = 100000;
+    std::thread producer([&]() {
+        for (int i = 0; i < count; i++) {
+            auto item = std::make_unique<int>(i);
+            queue.Push(item, abort);
+        }
+    });
+
+    bool ordered = true;
+    for (int i = 0; i < count; i++) {
+        std::unique_ptr<int> item;
+        queue.Pop(item, abort);
+        ordered = ordered && item && *item == i;
+    }
+    producer.join();
+
+    if (!ordered) {
+        throw std::runtime_error("SpscQueue lost or reordered items");
+    }
+    std::cout << "  ✓ SpscQueue keeps order under backpressure\n";
+
+    // Blocked operations give up once aborted
+    abort = true;
+    std::unique_ptr<int> item;
+    if (queue.Pop(item, abort)) {
+        throw std::runtime_error("SpscQueue::Pop ignored abort");
+    }
+    std::cout << "  ✓ SpscQueue abort\n";
+}
@@ -1,6 +1,306 @@
 #include "../src/CapnpReader.h"
+#include "../src/EventGenerator.h"
+#include "../src/FileFollower.h"
+#include "../src/FileSummary.h"
+#include "../src/SampleCopy.h"
 #include <iostream>
-#include <cassert>
+#include <algorithm>
+#include <map>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+
+// Writes a generated file and checks what CapnpReader decodes from it
+void check_roundtrip(int type, bool packed) {
+    GeneratorConfig config;
+    config.type = type;
+    config.events = 2500;
+    config.packetSize = 1000;
+    config.samples = 64;
+    config.boards = 2;
+    config.channels = 8;
+    config.packed = packed;
+
+    const std::string path = std::string("test_generated_") + EventGenerator::TypeName(type)
+                           + (packed ? ".cap" : "_unpacked.cap");
+    if (!EventGenerator(config).Write(path)) {
+        throw std::runtime_error("EventGenerator could not write " + path);
+    }
+
+    CapnpReader reader;
+    if (!reader.Open(path)) {
+        throw std::runtime_error("CapnpReader could not open " + path);
+    }
+    if (reader.IsMapped() == packed) {
+        throw std::runtime_error("CapnpReader misdetected the framing of " + path);
+    }
+
+    EventBatch batch;
+    int packets = 0;
+    while (reader.HasNext()) {
+        reader.ReadNextPacket(batch);
+        packets++;
+    }
+    reader.Close();
+    std::remove(path.c_str());
+
+    if (packets != 3 || batch.Size() != config.events) {
+        throw std::runtime_error(std::string("Roundtrip event count mismatch for ")
+                                 + EventGenerator::TypeName(type));
+    }
+    const bool waveforms = (type >= 2 && type <= 4) || type == 7;
+    const bool psd = type == 1 || type == 4 || type == 7;
+    size_t goodTriggers = 0;
+    for (size_t i = 0; i < batch.Size(); i++) {
+        if (batch.Mod[i] >= config.boards || batch.Ch[i] >= config.channels) {
+            throw std::runtime_error("Roundtrip board or channel out of range");
+        }
+        if (i > 0 && batch.TimeStamp[i] <= batch.TimeStamp[i - 1]) {
+            throw std::runtime_error("Roundtrip timestamps not increasing");
+        }
+        if (batch.RecordLength[i] != (waveforms ? config.samples : 0)
+            || batch.Trace2Size(i) != (type == 3 || type == 4 ? config.samples : 0)) {
+            throw std::runtime_error("Roundtrip trace length mismatch");
+        }
+        if (!psd && batch.ChargeShort[i] != 0) {
+            throw std::runtime_error("Roundtrip PSD set for a type without PSD");
+        }
+        if (type != 6 && batch.Extras[i] != 0) {
+            throw std::runtime_error("Roundtrip trigger flags set for a type without flags");
+        }
+        goodTriggers += (batch.Extras[i] & EventBatch::kGoodTrigger) != 0;
+    }
+    // The generator sets goodTrigger on about half of the CrossData events
+    if (type == 6 && (goodTriggers < batch.Size() / 4 || goodTriggers > batch.Size() * 3 / 4)) {
+        throw std::runtime_error("Roundtrip lost the CrossData trigger flags");
+    }
+}
+
+// Builds and saves the sidecar index of a generated file, then reads the
+// last packet directly through it
+void check_index(bool packed) {
+    GeneratorConfig config;
+    config.type = 2;
+    config.events = 2500;
+    config.packetSize = 1000;
+    config.samples = 16;
+    config.packed = packed;
+
+    const std::string path = packed ? "test_index_wave.cap" : "test_index_wave_unpacked.cap";
+    if (!EventGenerator(config).Write(path)) {
+        throw std::runtime_error("EventGenerator could not write " + path);
+    }
+
+    MessageIndex index;
+    if (!CapnpReader::BuildIndex(path, index, 2) || index.Size() != 3 || !index.Save(path)) {
+        throw std::runtime_error("CapnpReader could not index " + path);
+    }
+    if (index[1].type != 2 || index[1].events != 1000 || index.TotalEvents() != config.events
+        || index[1].minTimeStamp > index[1].maxTimeStamp) {
+        throw std::runtime_error("CapnpReader index summary mismatch");
+    }
+
+    CapnpReader reader;
+    EventBatch batch;
+    if (!reader.Open(path) || !reader.HasIndex() || reader.CountTotalEvents() != config.events
+        || !reader.SeekPacket(2) || reader.ReadNextPacket(batch) != 500
+        || batch.TimeStamp.front() < index[2].minTimeStamp
+        || batch.TimeStamp.back() > index[2].maxTimeStamp) {
+        throw std::runtime_error("CapnpReader random access through the index");
+    }
+    reader.Close();
+    std::remove(path.c_str());
+    std::remove(MessageIndex::SidecarPath(path).c_str());
+}
+
+// Reads a generated file with board, channel and time filters, with and
+// without a sidecar index; the index must only save work
+void check_filter() {
+    EventFilter parsed;
+    if (!parsed.ParseBoards("0,2-3") || !parsed.ParseTimeRange("100:") || parsed.ParseChannels("4-2")
+        || parsed.ParseChannels("256") || parsed.ParseTimeRange("7") || parsed.ParseTimeRange("9:9")
+        || !parsed.Accepts(3, 0, 100) || parsed.Accepts(1, 0, 100) || parsed.Accepts(0, 0, 99)
+        || parsed.Describe() != "time [100, end), boards 0,2-3") {
+        throw std::runtime_error("EventFilter parsing");
+    }
+
+    GeneratorConfig config;
+    config.type = 2;
+    config.events = 3000;
+    config.packetSize = 1000;
+    config.samples = 16;
+    config.boards = 2;
+    config.channels = 8;
+    const std::string path = "test_filter_wave.cap";
+    if (!EventGenerator(config).Write(path)) {
+        throw std::runtime_error("EventGenerator could not write " + path);
+    }
+
+    EventBatch all;
+    CapnpReader reader;
+    reader.Open(path);
+    while (reader.HasNext()) {
+        reader.ReadNextPacket(all);
+    }
+    reader.Close();
+
+    // A range inside the last packet, on board 1 channels 0-3
+    EventFilter filter;
+    const std::string range = std::to_string(all.TimeStamp[2100]) + ":"
+                            + std::to_string(all.TimeStamp[2900]);
+    if (!filter.ParseTimeRange(range) || !filter.ParseBoards("1") || !filter.ParseChannels("0-3")) {
+        throw std::runtime_error("EventFilter rejected a valid filter");
+    }
+    size_t expected = 0;
+    for (size_t i = 0; i < all.Size(); i++) {
+        expected += filter.Accepts(all.Mod[i], all.Ch[i], all.TimeStamp[i]);
+    }
+
+    for (bool indexed : {false, true}) {
+        MessageIndex index;
+        if (indexed && (!CapnpReader::BuildIndex(path, index) || !index.Save(path))) {
+            throw std::runtime_error("CapnpReader could not index " + path);
+        }
+        CapnpReader::ResetTypeCounts();
+        EventBatch selected;
+        reader.Open(path);
+        reader.SetFilter(filter);
+        while (reader.HasNext()) {
+            reader.ReadNextPacket(selected);
+        }
+        reader.Close();
+        if (selected.Size() != expected || expected == 0) {
+            throw std::runtime_error("CapnpReader filtered event count mismatch");
+        }
+        for (size_t i = 0; i < selected.Size(); i++) {
+            if (!filter.Accepts(selected.Mod[i], selected.Ch[i], selected.TimeStamp[i])
+                || selected.RecordLength[i] != config.samples) {
+                throw std::runtime_error("CapnpReader kept a filtered event");
+            }
+        }
+        // Only the last packet overlaps the range; the index skips the others
+        if (CapnpReader::DecodedTypeCounts()[2].packets != (indexed ? 1u : 3u)) {
+            throw std::runtime_error("CapnpReader did not skip packets through the index");
+        }
+    }
+    std::remove(path.c_str());
+    std::remove(MessageIndex::SidecarPath(path).c_str());
+}
+
+// Compares the decode-free summary of a generated file with its decoded
+// events, on one thread and on several
+void check_summary() {
+    GeneratorConfig config;
+    config.type = 4;
+    config.events = 5000;
+    config.packetSize = 700;
+    config.samples = 16;
+    config.boards = 3;
+    config.channels = 4;
+    config.disorder = 0.05;
+    const std::string path = "test_summary_full.cap";
+    if (!EventGenerator(config).Write(path)) {
+        throw std::runtime_error("EventGenerator could not write " + path);
+    }
+
+    EventBatch all;
+    CapnpReader reader;
+    reader.Open(path);
+    while (reader.HasNext()) {
+        reader.ReadNextPacket(all);
+    }
+    reader.Close();
+    std::map<unsigned, ChannelSummary> expected;
+    for (size_t i = 0; i < all.Size(); i++) {
+        ChannelSummary& channel = expected[all.Mod[i] * 256u + all.Ch[i]];
+        channel.events++;
+        channel.minTimeStamp = std::min(channel.minTimeStamp, all.TimeStamp[i]);
+        channel.maxTimeStamp = std::max(channel.maxTimeStamp, all.TimeStamp[i]);
+    }
+
+    for (unsigned threads : {1u, 3u}) {
+        FileSummary summary;
+        if (!summary.Build(path, threads) || !summary.Complete()
+            || summary.NumEvents() != config.events || summary.NumPackets() != 8
+            || summary.Types()[4].events != config.events
+            || summary.Channels().size() != expected.size()) {
+            throw std::runtime_error("FileSummary totals mismatch");
+        }
+        for (const auto& entry : summary.Channels()) {
+            const ChannelSummary& want = expected[entry.first];
+            if (entry.second.events != want.events || entry.second.minTimeStamp != want.minTimeStamp
+                || entry.second.maxTimeStamp != want.maxTimeStamp) {
+                throw std::runtime_error("FileSummary channel mismatch");
+            }
+        }
+    }
+    std::remove(path.c_str());
+}
+
+// Appends a generated file in uneven pieces, cutting messages in half, and
+// polls after each piece as --follow does
+void check_follow(bool packed) {
+    GeneratorConfig config;
+    config.type = 2;
+    config.events = 2500;
+    config.packetSize = 100;
+    config.samples = 32;
+    config.packed = packed;
+
+    const std::string source = "test_follow_source.cap";
+    const std::string growing = "test_follow_growing.cap";
+    EventGenerator(config).Write(source);
+    std::ifstream in(source, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::remove(source.c_str());
+
+    std::ofstream out(growing, std::ios::binary | std::ios::trunc);
+    FileFollower follower;
+    if (!follower.Open(growing)) {
+        throw std::runtime_error("FileFollower could not open " + growing);
+    }
+
+    EventBatch batch;
+    for (size_t pos = 0; pos < bytes.size(); ) {
+        size_t piece = std::min<size_t>(bytes.size() - pos, 1000 + pos % 777);
+        out.write(bytes.data() + pos, piece);
+        out.flush();
+        pos += piece;
+        follower.Poll(batch);
+    }
+    follower.Poll(batch);
+
+    if (batch.Size() != config.events || follower.NumPackets() != 25
+        || follower.PendingBytes() != 0) {
+        throw std::runtime_error("FileFollower lost events of a growing file");
+    }
+
+    // A segment table of 100000 segments can never complete, however much
+    // is appended
+    const char unpackedCorrupt[] = {'\xA0', '\x86', '\x01', 0, 1, 0, 0, 0};
+    const char packedCorrupt[] = {'\x17', '\xA0', '\x86', '\x01', 1};
+    if (packed) {
+        out.write(packedCorrupt, sizeof(packedCorrupt));
+    } else {
+        out.write(unpackedCorrupt, sizeof(unpackedCorrupt));
+    }
+    out.flush();
+    if (follower.Poll(batch) != 0 || !follower.Malformed()
+        || follower.BytesRead() - follower.PendingBytes() != bytes.size()) {
+        throw std::runtime_error("FileFollower waited on a malformed message");
+    }
+    std::remove(growing.c_str());
+    for (size_t i = 1; i < batch.Size(); i++) {
+        if (batch.TimeStamp[i] <= batch.TimeStamp[i - 1]) {
+            throw std::runtime_error("FileFollower delivered events out of order");
+        }
+    }
+}
+
+}  // namespace
 
 void test_reader() {
     std::cout << "Testing CapnpReader...\n";
@@ -9,7 +309,44 @@ void test_reader() {
     CapnpReader reader;
     std::cout << "  ✓ CapnpReader instantiation\n";
 
-    // Test: Can open a file (we'll test with actual file later)
-    // For now, just test the interface exists
-    std::cout << "  ✓ CapnpReader interface test\n";
+    // Test: Opening a missing file fails cleanly
+    if (reader.Open("does_not_exist.cap")) {
+        throw std::runtime_error("CapnpReader opened a missing file");
+    }
+    std::cout << "  ✓ CapnpReader missing file\n";
+
+    // Test: Every decoded type survives a generate/read roundtrip
+    for (int type = 0; type <= 7; type++) {
+        check_roundtrip(type, true);
+    }
+    check_roundtrip(2, false);
+    std::cout << "  ✓ CapnpReader roundtrip of generated files\n";
+
+    // Test: The sidecar index gives totals and random packet access
+    check_index(true);
+    check_index(false);
+    std::cout << "  ✓ CapnpReader sidecar index\n";
+
+    // Test: Filters drop events while decoding, and the index skips packets
+    check_filter();
+    std::cout << "  ✓ CapnpReader time range, board and channel filters\n";
+
+    // Test: The decode-free summary agrees with the decoded events
+    check_summary();
+    std::cout << "  ✓ FileSummary per-channel counts and time ranges\n";
+
+    // Test: Bulk sample copy keeps the bit pattern of negative Int16 samples
+    const uint8_t listBytes[] = {0x34, 0x12, 0xff, 0xff, 0x00, 0x80, 0x01, 0x00, 0xaa, 0x55};
+    uint16_t samples[6] = {0, 0, 0, 0, 0, 0xbeef};
+    CopySamples(listBytes, 5, samples);
+    if (samples[0] != 0x1234 || samples[1] != 0xffff || samples[2] != 0x8000
+        || samples[3] != 1 || samples[4] != 0x55aa || samples[5] != 0xbeef) {
+        throw std::runtime_error("CopySamples changed the little-endian samples");
+    }
+    std::cout << "  ✓ CopySamples bulk waveform copy\n";
+
+    // Test: A file read while it grows yields every event once
+    check_follow(true);
+    check_follow(false);
+    std::cout << "  ✓ FileFollower reads a growing file\n";
 }
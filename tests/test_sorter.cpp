@@ -0,0 +1,304 @@
+#include "../src/ExternalSorter.h"
+#include "../src/MultiFileSorter.h"
+#include "../src/RunMerger.h"
+#include "../src/ReorderBuffer.h"
+#include "../src/CapnpReader.h"
+#include "../src/EventGenerator.h"
+#include <iostream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdio>
+
+namespace {
+
+void test_run_merger() {
+    std::cout << "Testing RunMerger...\n";
+
+    // Four ascending (Mod,Ch) streams interleaved, one of them with a few
+    // backward jumps and one so disordered it must fall back to sorting.
+    // Events are observed in packet-sized slices, as the converter does.
+    EventBatch batch;
+    RunMerger merger(4);
+    for (int i = 0; i < 2000; i++) {
+        uint8_t mod = i % 2;
+        uint8_t ch = (i / 2) % 2;
+        int stream = mod * 2 + ch;
+        uint64_t ts = i * 10;
+        if (stream == 1) {
+            ts = (i % 500) * 40;
+        } else if (stream == 2) {
+            ts = (i * 7919) % 1013;
+        }
+        batch.Add(mod, ch, ts, ts, i, 0);
+
+        if ((i + 1) % 128 == 0 || i == 1999) {
+            merger.Observe(batch, i + 1 - ((i % 128) + 1));
+        }
+    }
+    if (merger.NumStreams() != 4) {
+        throw std::runtime_error("RunMerger stream detection failed");
+    }
+    std::cout << "  ✓ RunMerger found " << merger.NumRuns() << " runs in "
+              << merger.NumStreams() << " streams\n";
+
+    if (merger.Merge(batch) != batch.StableTimeOrder() || merger.NumSortedStreams() != 1) {
+        throw std::runtime_error("RunMerger order differs from stable sort");
+    }
+    std::cout << "  ✓ RunMerger matches in-memory stable sort\n";
+}
+
+void test_multi_file_sorter() {
+    std::cout << "Testing MultiFileSorter...\n";
+
+    // Three parts of a run with overlapping timestamp ranges and local
+    // disorder; read concurrently with a budget small enough to spill.
+    std::vector<std::string> files;
+    EventBatch concatenated;
+    for (int part = 0; part < 3; part++) {
+        GeneratorConfig config;
+        config.type = 2;
+        config.events = 3000;
+        config.packetSize = 100;
+        config.samples = 8;
+        config.spacing = 10 + part;
+        config.disorder = 0.05;
+        config.disorderWindow = 500;
+        config.seed = part + 1;
+
+        files.push_back("test_multi_part" + std::to_string(part) + ".cap");
+        if (!EventGenerator(config).Write(files.back())) {
+            throw std::runtime_error("EventGenerator could not write " + files.back());
+        }
+        CapnpReader reader;
+        reader.Open(files.back());
+        while (reader.HasNext()) {
+            reader.ReadNextPacket(concatenated);
+        }
+    }
+    std::vector<size_t> expected = concatenated.StableTimeOrder();
+
+    MultiFileSorter sorter(files, 64 * 1024, "", 2);
+    bool ok = sorter.Read();
+    if (!ok || sorter.NumEvents() != concatenated.Size() || sorter.NumChunks() < 3) {
+        throw std::runtime_error("MultiFileSorter read failed");
+    }
+
+    size_t pos = 0;
+    sorter.Merge([&](const EventBatch& batch, size_t i) {
+        if (pos >= expected.size()
+            || batch.TimeStamp[i] != concatenated.TimeStamp[expected[pos]]
+            || batch.ChargeLong[i] != concatenated.ChargeLong[expected[pos]]
+            || batch.Trace1(i)[0] != concatenated.Trace1(expected[pos])[0]) {
+            throw std::runtime_error("MultiFileSorter order differs from stable sort");
+        }
+        pos++;
+    });
+    for (const std::string& file : files) {
+        std::remove(file.c_str());
+    }
+    if (pos != expected.size()) {
+        throw std::runtime_error("MultiFileSorter lost events");
+    }
+    std::cout << "  ✓ MultiFileSorter merges " << files.size() << " files ("
+              << sorter.NumChunks() << " chunks) like a stable sort of their concatenation\n";
+
+    MultiFileSorter missing({"test_multi_missing.cap"}, 64 * 1024);
+    if (missing.Read() || missing.FailedFile() != "test_multi_missing.cap") {
+        throw std::runtime_error("MultiFileSorter accepted a missing file");
+    }
+    std::cout << "  ✓ MultiFileSorter reports a missing input\n";
+}
+
+void test_reorder_buffer() {
+    std::cout << "Testing ReorderBuffer...\n";
+
+    // Events at most 50 ticks out of order, with ties; ChargeLong records
+    // the arrival position so tie order can be checked
+    EventBatch input;
+    for (int i = 0; i < 3000; i++) {
+        uint64_t ts = 1000 + i * 5 - (i * 7919) % 10 * 5;
+        input.Add(0, 0, ts, ts, i, 0);
+    }
+    std::vector<size_t> expected = input.StableTimeOrder();
+
+    ReorderBuffer reorder(50);
+    size_t pos = 0;
+    size_t maxPending = 0;
+    auto sink = [&](const EventBatch& batch, size_t i) {
+        const size_t want = expected[pos++];
+        if (batch.TimeStamp[i] != input.TimeStamp[want]
+            || batch.ChargeLong[i] != input.ChargeLong[want]) {
+            throw std::runtime_error("ReorderBuffer order differs from stable sort");
+        }
+    };
+    for (size_t begin = 0; begin < input.Size(); begin += 64) {
+        EventBatch packet;
+        for (size_t i = begin; i < std::min(begin + 64, input.Size()); i++) {
+            packet.Append(input, i);
+        }
+        reorder.Add(packet);
+        reorder.Emit(sink);
+        maxPending = std::max(maxPending, reorder.Pending());
+    }
+    reorder.Flush(sink);
+    if (pos != input.Size() || reorder.NumViolations() != 0 || maxPending > 64 + 20) {
+        throw std::runtime_error("ReorderBuffer lost events or held too many");
+    }
+    std::cout << "  ✓ ReorderBuffer matches stable sort holding at most "
+              << maxPending << " events\n";
+
+    // An event older than the window is counted and still delivered
+    ReorderBuffer late(10);
+    EventBatch packet;
+    packet.Add(0, 0, 100, 100, 0, 0);
+    packet.Add(0, 0, 200, 200, 0, 0);
+    packet.Add(0, 0, 50, 50, 0, 0);
+    late.Add(packet);
+    size_t delivered = late.Emit([](const EventBatch&, size_t) {});
+    delivered += late.Flush([](const EventBatch&, size_t) {});
+    if (late.NumViolations() != 1 || delivered != 3) {
+        throw std::runtime_error("ReorderBuffer window violation not counted");
+    }
+    std::cout << "  ✓ ReorderBuffer counts window violations\n";
+
+    // A window near the top of the range keeps buffering instead of wrapping
+    ReorderBuffer wide(UINT64_MAX - 10);
+    EventBatch far;
+    far.Add(0, 0, 100, 100, 0, 0);
+    far.Add(0, 0, UINT64_MAX - 1, 0, 0, 0);
+    far.Add(0, 0, 50, 50, 0, 0);
+    wide.Add(far);
+    if (wide.Emit([](const EventBatch&, size_t) {}) != 0 || wide.NumViolations() != 0
+        || wide.Flush([](const EventBatch&, size_t) {}) != 3) {
+        throw std::runtime_error("ReorderBuffer window wrapped around");
+    }
+    std::cout << "  ✓ ReorderBuffer handles very large windows\n";
+}
+
+void test_sorter_block_size() {
+    std::cout << "Testing ExternalSorter read-back blocks...\n";
+
+    // Dual 8192-sample traces make every event about 32 KB, so a handful of
+    // events fills the budget and each chunk must be read back in a block
+    // smaller than the whole chunk.
+    const size_t kTraceLength = 8192;
+    const size_t kBudget = 256 * 1024;
+    const size_t kTraceBytes = 2 * kTraceLength * sizeof(uint16_t);
+
+    ExternalSorter sorter(kBudget);
+    for (int i = 0; i < 64; i++) {
+        EventBatch packet;
+        packet.Add(0, 0, 64 - i, 0, i, 0);
+        uint16_t* trace = packet.AddTraces(kTraceLength, kTraceLength);
+        for (size_t s = 0; s < 2 * kTraceLength; s++) {
+            trace[s] = i;
+        }
+        sorter.Add(packet);
+    }
+    sorter.Flush();
+    if (sorter.NumChunks() < 4) {
+        throw std::runtime_error("ExternalSorter did not spill long traces");
+    }
+
+    size_t events = 0;
+    uint64_t last = 0;
+    sorter.BeginMerge();
+    if (sorter.BlockBytes() != kBudget / sorter.NumChunks()) {
+        throw std::runtime_error("ExternalSorter block size does not split the budget");
+    }
+    const EventBatch* batch;
+    size_t index;
+    while (sorter.Next(batch, index)) {
+        // A block may overshoot by the event that crossed the limit
+        if (batch->Size() > 1
+            && batch->Samples.size() * sizeof(uint16_t) > sorter.BlockBytes() + kTraceBytes) {
+            throw std::runtime_error("ExternalSorter read-back block exceeds its share of the budget");
+        }
+        if (batch->TimeStamp[index] < last
+            || batch->Trace1(index)[kTraceLength - 1] != batch->ChargeLong[index]
+            || batch->Trace2Size(index) != kTraceLength) {
+            throw std::runtime_error("ExternalSorter corrupted long traces");
+        }
+        last = batch->TimeStamp[index];
+        events++;
+    }
+    if (events != 64) {
+        throw std::runtime_error("ExternalSorter lost long-trace events");
+    }
+
+    // Sorters merged together (MultiFileSorter) split a smaller merge budget
+    ExternalSorter shared(kBudget);
+    for (int i = 0; i < 16; i++) {
+        EventBatch packet;
+        packet.Add(0, 0, i, 0, i, 0);
+        packet.AddTraces(kTraceLength, kTraceLength);
+        shared.Add(packet);
+    }
+    shared.Flush();
+    shared.BeginMerge(kBudget / 4);
+    if (shared.BlockBytes() != kBudget / 4 / shared.NumChunks()) {
+        throw std::runtime_error("ExternalSorter ignored the merge budget");
+    }
+    events = 0;
+    while (shared.Next(batch, index)) {
+        events++;
+    }
+    if (events != 16) {
+        throw std::runtime_error("ExternalSorter lost events under a merge budget");
+    }
+    std::cout << "  ✓ ExternalSorter reads back blocks within the budget\n";
+}
+
+}  // namespace
+
+void test_sorter() {
+    test_run_merger();
+    test_reorder_buffer();
+    test_multi_file_sorter();
+    test_sorter_block_size();
+
+    std::cout << "Testing ExternalSorter...\n";
+
+    // Input with duplicate timestamps and traces; ChargeLong records the
+    // original position so ordering of ties can be checked.
+    EventBatch input;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t ts = (i * 7919) % 97;
+        input.Add(0, 0, ts, ts, i, 0);
+        uint16_t* trace = input.AddTraces(i % 5);
+        for (int s = 0; s < i % 5; s++) {
+            trace[s] = i;
+        }
+    }
+    std::vector<size_t> expected = input.StableTimeOrder();
+
+    // A tiny budget forces many spilled chunks plus an in-memory tail.
+    ExternalSorter sorter(4096);
+    for (size_t begin = 0; begin < input.Size(); begin += 50) {
+        EventBatch packet;
+        for (size_t i = begin; i < begin + 50; i++) {
+            packet.Append(input, i);
+        }
+        sorter.Add(packet);
+    }
+    if (sorter.NumChunks() < 2) {
+        throw std::runtime_error("ExternalSorter did not spill");
+    }
+    std::cout << "  ✓ ExternalSorter spills to " << sorter.NumChunks() << " chunks\n";
+
+    size_t pos = 0;
+    sorter.Merge([&](const EventBatch& batch, size_t i) {
+        if (pos >= expected.size()
+            || batch.TimeStamp[i] != input.TimeStamp[expected[pos]]
+            || batch.ChargeLong[i] != input.ChargeLong[expected[pos]]
+            || batch.RecordLength[i] != input.RecordLength[expected[pos]]
+            || (batch.RecordLength[i] > 0 && batch.Trace1(i)[0] != batch.ChargeLong[i])) {
+            throw std::runtime_error("ExternalSorter order differs from stable sort");
+        }
+        pos++;
+    });
+    if (pos != expected.size()) {
+        throw std::runtime_error("ExternalSorter lost events");
+    }
+    std::cout << "  ✓ ExternalSorter matches in-memory stable sort\n";
+}
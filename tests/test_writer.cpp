@@ -1,6 +1,13 @@
 #include "../src/RootWriter.h"
+#include "../src/BatchConverter.h"
+#include "../src/EventGenerator.h"
 #include <iostream>
-#include <cassert>
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+#include <algorithm>
+#include <sys/stat.h>
+#include <unistd.h>
 
 void test_writer() {
     std::cout << "Testing RootWriter...\n";
@@ -21,4 +28,157 @@ void test_writer() {
 
     writer.Close();
     std::cout << "  ✓ RootWriter Close test\n";
+
+    // Test: Signal follows each event's trace, including a reused TreeData
+    // whose Trace1 reallocates, a short trace and an EventBatch view
+    {
+        RootWriter signalWriter("test_signal.root");
+        TreeData event;
+        for (uint32_t length : {4u, 64u, 0u, 16u}) {
+            event.RecordLength = length;
+            event.Trace1.assign(length, static_cast<uint16_t>(length));
+            signalWriter.Fill(event);
+        }
+        event.RecordLength = 8;
+        event.Trace1.assign(3, 7);
+        signalWriter.Fill(event);
+
+        EventBatch batch;
+        batch.Add(0, 0, 0, 0, 0, 0);
+        uint16_t* trace = batch.AddTraces(5);
+        std::fill(trace, trace + 5, 5);
+        signalWriter.Fill(batch.View(0));
+        signalWriter.Close();
+    }
+    {
+        TFile file("test_signal.root");
+        TTree* tree = file.Get<TTree>("ELIADE_Tree");
+        uint32_t recordLength = 0;
+        uint16_t signal[64];
+        tree->SetBranchAddress("RecordLength", &recordLength);
+        tree->SetBranchAddress("Signal", signal);
+
+        const uint32_t lengths[] = {4, 64, 0, 16, 8, 5};
+        if (tree->GetEntries() != 6) {
+            throw std::runtime_error("Signal test entry count mismatch");
+        }
+        for (int entry = 0; entry < 6; entry++) {
+            tree->GetEntry(entry);
+            if (recordLength != lengths[entry]) {
+                throw std::runtime_error("Signal test record length mismatch");
+            }
+            for (uint32_t s = 0; s < recordLength; s++) {
+                uint16_t expected = entry == 4 ? (s < 3 ? 7 : 0) : recordLength;
+                if (signal[s] != expected) {
+                    throw std::runtime_error("Signal branch holds stale trace data");
+                }
+            }
+        }
+    }
+    std::cout << "  ✓ RootWriter Signal branch contents\n";
+
+    // Test: FillBatch writes columns in the given order, with and without traces
+    {
+        EventBatch plain;
+        EventBatch waves;
+        for (int i = 0; i < 10; i++) {
+            plain.Add(i % 2, i, 100 - i, 0, i, 0);
+            waves.Add(i % 2, i, 100 - i, 0, i, 0);
+            uint16_t* trace = waves.AddTraces(i);
+            std::fill(trace, trace + i, static_cast<uint16_t>(i));
+        }
+        std::vector<size_t> order = plain.StableTimeOrder();
+
+        RootWriter batchWriter("test_batch.root");
+        batchWriter.FillBatch(plain, 0, 4, &order);
+        batchWriter.FillBatch(plain, 4, 10, &order);
+        batchWriter.FillBatch(waves);
+        batchWriter.Close();
+
+        TFile file("test_batch.root");
+        TTree* tree = file.Get<TTree>("ELIADE_Tree");
+        uint64_t timeStamp = 0;
+        uint32_t recordLength = 0;
+        uint16_t signal[16];
+        tree->SetBranchAddress("TimeStamp", &timeStamp);
+        tree->SetBranchAddress("RecordLength", &recordLength);
+        tree->SetBranchAddress("Signal", signal);
+        if (tree->GetEntries() != 20) {
+            throw std::runtime_error("FillBatch entry count mismatch");
+        }
+        for (int entry = 0; entry < 20; entry++) {
+            tree->GetEntry(entry);
+            bool sorted = entry < 10;
+            uint32_t i = sorted ? 9 - entry : entry - 10;
+            if (timeStamp != 100 - i || recordLength != (sorted ? 0 : i)) {
+                throw std::runtime_error("FillBatch wrote events out of order");
+            }
+            for (uint32_t s = 0; s < recordLength; s++) {
+                if (signal[s] != i) {
+                    throw std::runtime_error("FillBatch wrote the wrong trace");
+                }
+            }
+        }
+    }
+    std::cout << "  ✓ RootWriter FillBatch\n";
+
+    // Test: Compression specs map to ROOT settings (100 * algorithm + level)
+    int compression = -1;
+    if (!RootWriter::ParseCompression("lz4:4", compression) || compression != 404
+        || !RootWriter::ParseCompression("zstd:5", compression) || compression != 505
+        || !RootWriter::ParseCompression("zlib", compression) || compression != 101
+        || !RootWriter::ParseCompression("none", compression) || compression != 0) {
+        throw std::runtime_error("ParseCompression rejected a valid spec");
+    }
+    if (RootWriter::ParseCompression("lz4:12", compression)
+        || RootWriter::ParseCompression("gzip:1", compression)) {
+        throw std::runtime_error("ParseCompression accepted an invalid spec");
+    }
+    std::cout << "  ✓ RootWriter compression spec parsing\n";
+
+    // Test: Batch mode converts a directory on two threads, skips an
+    // existing output and sends a file larger than the budget through the
+    // external sorter
+    {
+        const std::string dir = "test_batch_dir";
+        mkdir(dir.c_str(), 0755);
+        GeneratorConfig config;
+        config.type = 2;
+        config.samples = 16;
+        for (int part = 0; part < 3; part++) {
+            config.events = part == 0 ? 20000 : 500;
+            config.seed = part + 1;
+            EventGenerator(config).Write(dir + "/run_" + std::to_string(part) + ".cap");
+        }
+        std::ofstream(dir + "/run_2.root") << "done";
+
+        BatchSettings settings;
+        settings.threads = 2;
+        settings.memoryBudget = BatchConverter::EstimateMemory(100000);
+        BatchConverter converter(settings);
+        if (!converter.Plan(dir) || converter.NumSkipped() != 1 || converter.Jobs().size() != 2) {
+            throw std::runtime_error("BatchConverter planned the wrong jobs");
+        }
+        if (!converter.Jobs()[0].external || converter.Jobs()[1].external) {
+            throw std::runtime_error("BatchConverter chose the wrong sorter for the budget");
+        }
+        if (converter.Run() != 0 || converter.NumConverted() != 2) {
+            throw std::runtime_error("BatchConverter failed");
+        }
+
+        for (int part = 0; part < 2; part++) {
+            std::string output = dir + "/run_" + std::to_string(part) + ".root";
+            TFile file(output.c_str());
+            TTree* tree = file.Get<TTree>("ELIADE_Tree");
+            if (!tree || tree->GetEntries() != (part == 0 ? 20000 : 500)) {
+                throw std::runtime_error("BatchConverter output incomplete: " + output);
+            }
+        }
+        for (int part = 0; part < 3; part++) {
+            std::remove((dir + "/run_" + std::to_string(part) + ".cap").c_str());
+            std::remove((dir + "/run_" + std::to_string(part) + ".root").c_str());
+        }
+        rmdir(dir.c_str());
+    }
+    std::cout << "  ✓ BatchConverter directory conversion\n";
 }